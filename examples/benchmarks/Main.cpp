@@ -11,6 +11,8 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <tuple>
+#include <vector>
 
 constexpr i32 NUM_ENTITIES = 100000;
 constexpr i32 BENCHMARK_DURATION_SECONDS = 10;
@@ -36,18 +38,32 @@ static void setup_system(r::ecs::Commands &commands)
     r::Logger::info("Benchmark Setup: Spawning " + std::to_string(NUM_ENTITIES) + " entities...");
     srand(time(nullptr));
 
-    for (i32 i = 0; i < NUM_ENTITIES; ++i) {
-        auto entity =
-            commands.spawn(r::Transform3d{.position = {(f32) (rand() % 200 - 100), (f32) (rand() % 200 - 100), (f32) (rand() % 200 - 100)}},
-                Velocity{.value = {(f32) (rand() % 20 - 10), (f32) (rand() % 20 - 10), 0.0f}});
+    std::vector<std::tuple<r::Transform3d, Velocity>> plain;
+    std::vector<std::tuple<r::Transform3d, Velocity, Acceleration>> accelerated;
+    std::vector<std::tuple<r::Transform3d, Velocity, HeavyData>> heavy;
+    std::vector<std::tuple<r::Transform3d, Velocity, Acceleration, HeavyData>> accelerated_heavy;
 
-        if (i % 2 == 0) {
-            entity.insert(Acceleration{.value = {0.0f, -9.81f, 0.0f}});
-        }
-        if (i % 3 == 0) {
-            entity.insert(HeavyData{});
+    for (i32 i = 0; i < NUM_ENTITIES; ++i) {
+        const r::Transform3d transform{.position = {(f32) (rand() % 200 - 100), (f32) (rand() % 200 - 100), (f32) (rand() % 200 - 100)}};
+        const Velocity velocity{.value = {(f32) (rand() % 20 - 10), (f32) (rand() % 20 - 10), 0.0f}};
+        const Acceleration acceleration{.value = {0.0f, -9.81f, 0.0f}};
+
+        if (i % 2 == 0 && i % 3 == 0) {
+            accelerated_heavy.emplace_back(transform, velocity, acceleration, HeavyData{});
+        } else if (i % 2 == 0) {
+            accelerated.emplace_back(transform, velocity, acceleration);
+        } else if (i % 3 == 0) {
+            heavy.emplace_back(transform, velocity, HeavyData{});
+        } else {
+            plain.emplace_back(transform, velocity);
         }
     }
+
+    /* one bulk append per archetype instead of one archetype move per inserted component */
+    commands.spawn_batch(std::move(plain));
+    commands.spawn_batch(std::move(accelerated));
+    commands.spawn_batch(std::move(heavy));
+    commands.spawn_batch(std::move(accelerated_heavy));
 }
 
 static void move_system(r::ecs::Query<r::ecs::Ref<Velocity>, r::ecs::Mut<r::Transform3d>> query, r::ecs::Res<r::core::FrameTime> time)
@@ -73,12 +89,11 @@ static void apply_acceleration_system(r::ecs::Query<r::ecs::Ref<Acceleration>, r
 
 static void heavy_computation_A(r::ecs::Query<r::ecs::Ref<r::Transform3d>> query)
 {
-    for (const auto &[trans] : query) {
-
+    query.par_for_each(4096, [](r::ecs::Ref<r::Transform3d> trans) {
         volatile f32 result = 0.f;
         for (i32 i = 0; i < 20; ++i)
             result += std::sin(trans.ptr->position.x) * std::cos(result);
-    }
+    });
 }
 static void heavy_computation_B(r::ecs::Query<r::ecs::Ref<Velocity>> query)
 {
@@ -5,6 +5,7 @@
 #include <R-Engine/R-EngineExport.hpp>
 
 #include <R-Engine/Core/Clock.hpp>
+#include <R-Engine/Core/Extracted.hpp>
 #include <R-Engine/Core/Flagable.hpp>
 
 #include <R-Engine/ECS/RunConditions.hpp>
@@ -40,7 +41,8 @@ enum class Schedule {
     RENDER_3D        = 1 << 8,
     AFTER_RENDER_3D  = 1 << 9,
     SHUTDOWN         = 1 << 10,
-    EVENT_CLEANUP    = 1 << 11
+    EVENT_CLEANUP    = 1 << 11,
+    EXTRACT          = 1 << 12
 };
 R_ENUM_FLAGABLE(Schedule)
 
@@ -51,6 +53,7 @@ class R_ENGINE_API Application final
     private:
         std::unordered_map<std::type_index, sys::States> _states;
         std::vector<std::function<void()>> _state_transition_runners;
+        std::vector<std::function<bool()>> _state_transition_pending;
 
         using ScheduleMap = std::unordered_map<Schedule, sys::ScheduleGraph>;
         friend class sys::SystemConfigurator;
@@ -115,6 +118,32 @@ class R_ENGINE_API Application final
         template<typename... EventTs>
         Application &add_events(void) noexcept;
 
+        /**
+        * @brief copies the resource T into a core::Extracted<T> resource during every EXTRACT schedule
+        * @details render systems read the copy, so they draw the frame it was taken from even when the
+        * next frame already changed T. T should be inserted first, otherwise an error is logged and the copy
+        * starts from a default constructed T (absent if T has no default constructor).
+        */
+        template<typename T>
+        Application &extract_resource() noexcept;
+
+        /**
+        * @brief enables pipelined frames: the render of a frame overlaps the UPDATE of the next one
+        * @details EXTRACT runs at the end of each frame, then the next frame begins (clock tick and state
+        * transitions) and its UPDATE runs in a single graph with the render schedules of the extracted frame,
+        * so a simulation system only waits for the render systems it conflicts with. render systems read
+        * what EXTRACT copied (core::Extracted<T>, the mesh snapshot). plugins read this flag when they are
+        * built: call it before adding them.
+        * a frame whose next one starts with a state transition is rendered before the transition runs, and
+        * the last frame is rendered once quit is set, so both modes draw the same frames.
+        */
+        Application &set_pipelined(bool pipelined) noexcept;
+
+        /**
+        * @brief checks if pipelined frames are enabled
+        */
+        bool is_pipelined() const noexcept;
+
         /**
         * @brief run the application
         * @details this will start the main loop of the application
@@ -128,6 +157,9 @@ class R_ENGINE_API Application final
         *     for (each fixed timestep) {
         *         FIXED_UPDATE systems();
         *     }
+        *
+        *     EXTRACT systems();
+        *     render systems();
         * }
         *
         * SHUTDOWN systems();
@@ -162,7 +194,11 @@ class R_ENGINE_API Application final
         void _startup();
         void _main_loop();
         void _shutdown();
-        void _render_routine();
+        void _begin_frame();
+        void _run_fixed_updates();
+        void _extract_frame();
+        bool _has_pending_transition() const;
+        void _render_routine(bool with_next_update);
         void _run_schedule(const Schedule sched);
         void _apply_commands();
         void _apply_state_transitions();
@@ -181,11 +217,13 @@ class R_ENGINE_API Application final
         core::Clock _clock = {};
         ScheduleMap _systems = {};
         ecs::Scene _scene = {};
-        ecs::CommandBuffer _command_buffer = {};
+        ecs::CommandBuffer _command_buffer{&_scene};
 
         std::unique_ptr<core::ThreadPool> _thread_pool;
         std::unique_ptr<core::Scheduler> _scheduler;
         std::vector<std::unique_ptr<ecs::CommandBuffer>> _thread_local_command_buffers;
+        std::vector<sys::ScheduleGraph *> _render_chain; /**< Reused by _render_routine every frame. */
+        bool _pipelined = false;
 };
 
 }// namespace r
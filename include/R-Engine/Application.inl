@@ -1,9 +1,12 @@
 #pragma once
 
 #include <array>
+#include <R-Engine/Core/Logger.hpp>
 #include <R-Engine/Plugins/Plugin.hpp>
 
+#include <string>
 #include <type_traits>
+#include <typeinfo>
 #include <utility>
 
 namespace r::details {
@@ -39,6 +42,17 @@ static inline void __update_events_system(ecs::ResMut<ecs::Events<EventT>> event
     }
 }
 
+/**
+* @brief system copying a resource for the render schedules, see Application::extract_resource
+*/
+template<typename T>
+static inline void __extract_resource_system(ecs::Res<T> source, ecs::ResMut<core::Extracted<T>> target)
+{
+    if (source.ptr && target.ptr) {
+        target.ptr->value = *source.ptr;
+    }
+}
+
 /**
  * @brief Schedules that can only run on the main thread
  * @details These schedules often involve operations that are not thread-safe,
@@ -69,9 +83,9 @@ T *r::Application::get_resource_ptr() noexcept
 }
 
 template<auto SystemFunc>
-static void system_invoker_template(r::ecs::Scene &scene, r::ecs::CommandBuffer &cmd)
+static void system_invoker_template(r::ecs::Scene &scene, r::ecs::CommandBuffer &cmd, void *state)
 {
-    r::ecs::run_system(SystemFunc, scene, cmd);
+    r::ecs::run_system(SystemFunc, scene, cmd, *static_cast<r::ecs::system_state_t<decltype(SystemFunc)> *>(state));
 }
 
 template<typename SetType>
@@ -129,6 +143,22 @@ r::Application &r::Application::add_events() noexcept
     return *this;
 }
 
+template<typename T>
+r::Application &r::Application::extract_resource() noexcept
+{
+    if (const T *resource = _scene.get_resource_ptr<T>()) {
+        insert_resource(core::Extracted<T>{*resource});
+    } else if constexpr (std::is_default_constructible_v<T>) {
+        Logger::error(std::string("extract_resource: ") + typeid(T).name() + " is not inserted yet, extracting a default value");
+        insert_resource(core::Extracted<T>{});
+    } else {
+        Logger::error(std::string("extract_resource: ") + typeid(T).name() + " is not inserted yet, nothing to extract until the first frame");
+    }
+    add_systems<details::__extract_resource_system<T>>(Schedule::EXTRACT);
+
+    return *this;
+}
+
 template<auto SystemFunc>
 r::sys::SystemTypeId r::Application::_add_one_system_to_graph(sys::ScheduleGraph &graph, bool main_thread_only) noexcept
 {
@@ -136,6 +166,8 @@ r::sys::SystemTypeId r::Application::_add_one_system_to_graph(sys::ScheduleGraph
     sys::SystemNode node(id.name(), id, &system_invoker_template<SystemFunc>, {});
 
     node.is_main_thread_only = main_thread_only;
+    node.state = std::make_shared<ecs::system_state_t<decltype(SystemFunc)>>();
+    ecs::init_system_params<decltype(SystemFunc)>(_scene);
 
     ecs::get_system_access<SystemFunc>(node.component_access, node.resource_access);
 
@@ -155,6 +187,13 @@ r::Application &r::Application::init_state(T initial_state) noexcept
     insert_resource(State<T>(initial_state));
     insert_resource(NextState<T>{.next = initial_state});
 
+    _state_transition_pending.push_back([this]() {
+        const auto *state_res = _scene.get_resource_ptr<State<T>>();
+        const auto *next_state_res = _scene.get_resource_ptr<NextState<T>>();
+
+        /* the runner also clears the previous state of the last transition */
+        return (next_state_res && next_state_res->next.has_value()) || (state_res && state_res->previous().has_value());
+    });
     _state_transition_runners.push_back([this]() {
         auto *state_res = _scene.get_resource_ptr<State<T>>();
         auto *next_state_res = _scene.get_resource_ptr<NextState<T>>();
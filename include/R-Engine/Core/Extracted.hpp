@@ -0,0 +1,20 @@
+#pragma once
+
+namespace r {
+
+namespace core {
+
+/**
+ * @brief copy of the resource T taken during the EXTRACT schedule, for the render schedules of the same frame
+ * @details with pipelined frames the next frame already ticks, runs its state transitions and updates T
+ * while the current one is drawn, so render systems read Extracted<T> instead of T.
+ * see Application::extract_resource.
+ */
+template<typename T>
+struct Extracted {
+        T value;
+};
+
+}// namespace core
+
+}// namespace r
@@ -1,20 +1,103 @@
 #pragma once
 
-template<class F, class... Args>
-auto r::core::ThreadPool::enqueue(F &&f, Args &&...args) -> std::future<typename std::invoke_result<F, Args...>::type>
+/**
+* TaskHandle
+*/
+
+template<typename R>
+r::core::TaskHandle<R>::TaskHandle(ThreadPool *pool, detail::TaskResult<R> *task) noexcept : _pool(pool), _task(task)
+{
+    /* __ctor__ */
+}
+
+template<typename R>
+r::core::TaskHandle<R>::~TaskHandle()
 {
-    using return_type = typename std::invoke_result<F, Args...>::type;
+    if (_task) {
+        _task->release();
+    }
+}
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+template<typename R>
+r::core::TaskHandle<R>::TaskHandle(TaskHandle &&other) noexcept : _pool(std::exchange(other._pool, nullptr)), _task(std::exchange(other._task, nullptr))
+{
+    /* __ctor__ */
+}
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(_queue_mutex);
-        if (_stop) {
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+template<typename R>
+r::core::TaskHandle<R> &r::core::TaskHandle<R>::operator=(TaskHandle &&other) noexcept
+{
+    if (this != &other) {
+        if (_task) {
+            _task->release();
         }
-        _tasks.emplace([task]() { (*task)(); });
+        _pool = std::exchange(other._pool, nullptr);
+        _task = std::exchange(other._task, nullptr);
     }
-    _condition.notify_one();
-    return res;
+    return *this;
+}
+
+template<typename R>
+bool r::core::TaskHandle<R>::valid() const noexcept
+{
+    return _task != nullptr;
+}
+
+template<typename R>
+bool r::core::TaskHandle<R>::is_ready() const noexcept
+{
+    return _task && _task->done.load(std::memory_order_acquire) != 0;
+}
+
+template<typename R>
+void r::core::TaskHandle<R>::wait() const
+{
+    if (!_task) {
+        throw std::runtime_error("wait on an empty TaskHandle");
+    }
+    if (_task->done.load(std::memory_order_acquire) == 0) {
+        _pool->_wait(*_task);
+    }
+}
+
+template<typename R>
+R r::core::TaskHandle<R>::get()
+{
+    wait();
+
+    /* the handle is emptied first, so the task is released even if the result throws */
+    const std::unique_ptr<detail::TaskResult<R>, void (*)(detail::TaskResult<R> *)> task(std::exchange(_task, nullptr),
+        [](detail::TaskResult<R> *t) { t->release(); });
+
+    _pool = nullptr;
+    if (task->error) {
+        std::rethrow_exception(task->error);
+    }
+    if constexpr (!std::is_void_v<R>) {
+        return std::move(*task->result);
+    }
+}
+
+/**
+* ThreadPool
+*/
+
+template<class F, class... Args>
+auto r::core::ThreadPool::enqueue(F &&f, Args &&...args) -> TaskHandle<std::invoke_result_t<F, Args...>>
+{
+    using return_type = std::invoke_result_t<F, Args...>;
+
+    if (_stop.load(std::memory_order_acquire)) {
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+    }
+
+    auto bound = [func = std::forward<F>(f), ... bound_args = std::forward<Args>(args)]() mutable -> return_type {
+        return std::invoke(func, bound_args...);
+    };
+    auto *task = new detail::TaskOf<decltype(bound), return_type>(std::move(bound));
+
+    /* one reference for the pool, released once the task ran, and one for the handle */
+    task->refs.store(2, std::memory_order_relaxed);
+    _submit(task);
+    return TaskHandle<return_type>(this, task);
 }
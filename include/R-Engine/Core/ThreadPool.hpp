@@ -1,21 +1,155 @@
 #pragma once
 
 #include <R-Engine/R-EngineExport.hpp>
+#include <R-Engine/Types.hpp>
 
-#include <condition_variable>
+#include <atomic>
+#include <exception>
 #include <functional>
-#include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace r {
 
 namespace core {
 
+class ThreadPool;
+
+namespace detail {
+
+/**
+* @brief type erased task, allocated once per enqueue and shared by the pool and its TaskHandle
+* @details refs counts the owners (the pool until the task ran, the handle until it is dropped),
+* done flips to 1 once the callable returned or threw, and is waited on with std::atomic::wait.
+*/
+struct Task {
+        using RunFn = void (*)(Task *) noexcept;
+        using DestroyFn = void (*)(Task *) noexcept;
+
+        std::atomic<u32> refs{1};
+        std::atomic<u32> done{0};
+        std::exception_ptr error;
+        RunFn run = nullptr;
+        DestroyFn destroy = nullptr;
+
+        void release() noexcept
+        {
+            if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                destroy(this);
+            }
+        }
+};
+
+/**
+* @brief the part of a task a TaskHandle<R> sees, the callable type is erased
+*/
+template<typename R>
+struct TaskResult : Task {
+        std::optional<R> result;
+};
+
+template<>
+struct TaskResult<void> : Task {
+};
+
+template<typename F, typename R>
+struct TaskOf final : TaskResult<R> {
+        F func;
+
+        explicit TaskOf(F &&f) : func(std::move(f))
+        {
+            this->run = &TaskOf::_run;
+            this->destroy = &TaskOf::_destroy;
+        }
+
+    private:
+        static void _run(Task *base) noexcept
+        {
+            auto *self = static_cast<TaskOf *>(base);
+
+            try {
+                if constexpr (std::is_void_v<R>) {
+                    std::invoke(self->func);
+                } else {
+                    self->result.emplace(std::invoke(self->func));
+                }
+            } catch (...) {
+                self->error = std::current_exception();
+            }
+            self->done.store(1, std::memory_order_release);
+            self->done.notify_all();
+        }
+
+        static void _destroy(Task *base) noexcept
+        {
+            delete static_cast<TaskOf *>(base);
+        }
+};
+
+}// namespace detail
+
+/**
+* @brief handle to a task enqueued on a ThreadPool, the lightweight counterpart of std::future
+* @details the task and its result share a single allocation with the pool, there is no shared state
+* mutex nor condition variable: waiting spins on an atomic flag and then parks on it.
+* a worker waiting on a handle of its own pool runs other tasks in the meantime, so tasks may wait on
+* the tasks they enqueued without starving the pool.
+*/
+template<typename R>
+class TaskHandle
+{
+    public:
+        TaskHandle() = default;
+        ~TaskHandle();
+
+        TaskHandle(const TaskHandle &) = delete;
+        TaskHandle &operator=(const TaskHandle &) = delete;
+        TaskHandle(TaskHandle &&other) noexcept;
+        TaskHandle &operator=(TaskHandle &&other) noexcept;
+
+        /**
+        * @brief checks if the handle refers to a task
+        */
+        bool valid() const noexcept;
+
+        /**
+        * @brief checks if the task finished, without blocking
+        */
+        bool is_ready() const noexcept;
+
+        /**
+        * @brief blocks until the task finished
+        */
+        void wait() const;
+
+        /**
+        * @brief waits for the task and returns its result, rethrowing the exception it threw
+        * @info like std::future::get, the result is moved out and the handle is left empty
+        */
+        R get();
+
+    private:
+        friend class ThreadPool;
+
+        TaskHandle(ThreadPool *pool, detail::TaskResult<R> *task) noexcept;
+
+        ThreadPool *_pool = nullptr;
+        detail::TaskResult<R> *_task = nullptr;
+};
+
 /**
 * @brief Thread pool for managing and executing tasks concurrently.
+* @details every worker owns a Chase-Lev deque: it pushes and pops its own tasks at the bottom without
+* any lock, idle workers steal from the top of the other deques. tasks enqueued from outside the pool
+* go to a shared injection deque, which is only locked by the submitting threads, workers steal from
+* it like from any other deque. a worker that finds nothing spins for a little while before parking on
+* an atomic, and submitters only pay for a wake-up when a worker is actually parked.
 */
 class R_ENGINE_API ThreadPool
 {
@@ -23,17 +157,48 @@ class R_ENGINE_API ThreadPool
         explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
         ~ThreadPool();
 
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+        * @brief runs f(args...) on the pool
+        * @info a pool without workers runs the task inline, before returning the handle
+        */
         template<class F, class... Args>
-        auto enqueue(F &&f, Args &&...args) -> std::future<typename std::invoke_result<F, Args...>::type>;
+        auto enqueue(F &&f, Args &&...args) -> TaskHandle<std::invoke_result_t<F, Args...>>;
+
+        /**
+        * @brief calls func(i) for every i in [0, count) across the pool and returns once all calls are done
+        * @details the calling thread works on the range too, and helpers only pick up indices that are not
+        * claimed yet, so this is safe to call from a task running on the pool itself.
+        * the first exception thrown by func is rethrown on the calling thread.
+        */
+        void parallel_for(size_t count, const std::function<void(size_t)> &func);
+
+        /**
+        * @brief number of worker threads
+        */
+        size_t size() const noexcept;
 
     private:
-        std::vector<std::thread> _workers;
-        std::queue<std::function<void()>> _tasks;
-        std::mutex _queue_mutex;
-        std::condition_variable _condition;
-        bool _stop;
+        template<typename R>
+        friend class TaskHandle;
+
+        struct Worker;
+        struct Deque;
+
+        void _submit(detail::Task *task);
+        void _wait(const detail::Task &task);
+        detail::Task *_find_work(size_t self, bool &contended);
+        void _wake_one() noexcept;
+        void _arbeit(size_t index);
 
-        void _arbeit();
+        std::vector<std::unique_ptr<Worker>> _workers;
+        std::unique_ptr<Deque> _injector;
+        std::mutex _injector_mutex;
+        std::atomic<u32> _epoch{0};
+        std::atomic<u32> _sleepers{0};
+        std::atomic<bool> _stop{false};
 };
 
 }// namespace core
@@ -3,8 +3,9 @@
 #include <R-Engine/ECS/Entity.hpp>
 #include <R-Engine/ECS/Scene.hpp>
 
-#include <functional>
-#include <limits>
+#include <cstddef>
+#include <memory>
+#include <tuple>
 #include <vector>
 
 namespace r::ecs {
@@ -26,9 +27,10 @@ class R_ENGINE_API ChildBuilder
 
         /**
          * @brief Spawn a child entity with components
+         * @throws r::exception::Error if no entity index is left, see Commands::spawn.
          */
         template<typename... Components>
-        EntityCommands spawn(Components &&...components) noexcept;
+        EntityCommands spawn(Components &&...components);
 
     private:
         Commands *_commands;
@@ -60,23 +62,94 @@ class R_ENGINE_API EntityCommands
 
         /**
          * @brief Returns the entity's ID.
-         * @details If the entity was just spawned, this is a temporary placeholder ID
-         * that is only valid within this command buffer cycle.
+         * @details If the entity was just spawned, the ID is reserved in the scene but the entity is only
+         * alive once the command buffer is applied. The ID can be used in any command buffer meanwhile.
          */
         Entity id() const noexcept;
 
         /**
          * @brief Spawn child entities for this entity.
          * @param builder_fn Function that receives a ChildBuilder to spawn children.
+         * @throws r::exception::Error if no entity index is left, see Commands::spawn.
          */
         template<typename FuncT>
-        EntityCommands &with_children(FuncT &&func) noexcept;
+        EntityCommands &with_children(FuncT &&func);
 
     private:
         CommandBuffer *_buffer;
         Entity _entity;
 };
 
+/**
+ * @brief Bump allocator holding the commands recorded in a CommandBuffer.
+ * @details Memory is carved out of blocks that are kept from one frame to the next, so recording a command
+ * does not touch the heap once the arena has warmed up and reset() only rewinds the cursor.
+ * Allocations never move, payloads do not need to be relocatable.
+ */
+class R_ENGINE_API CommandArena
+{
+    public:
+        static constexpr usize BLOCK_SIZE = 64 * 1024;
+
+        CommandArena() = default;
+        ~CommandArena();
+
+        CommandArena(const CommandArena &) = delete;
+        CommandArena &operator=(const CommandArena &) = delete;
+
+        /**
+         * @brief Allocates uninitialized memory valid until the next reset().
+         * @param size The size of the allocation in bytes.
+         * @param alignment The alignment of the allocation, a power of two.
+         */
+        void *allocate(usize size, usize alignment);
+
+        /**
+         * @brief Releases every allocation at once, the blocks are kept for reuse.
+         * @details Does not run any destructor, see CommandBuffer for payload lifetimes.
+         */
+        void reset() noexcept;
+
+    private:
+        struct Block {
+                std::byte *data;
+                usize size;
+        };
+
+        std::vector<Block> _blocks;
+        usize _block = 0;
+        usize _offset = 0;
+};
+
+/**
+ * @brief Kind of a recorded command.
+ * @details Untyped commands are executed by the CommandBuffer itself, typed ones go through CommandRecord::apply.
+ */
+enum class CommandOp : u8 {
+    Spawn,
+    SpawnBundle,
+    Despawn,
+    AddChild,
+    Insert,
+    Remove,
+    Custom
+};
+
+/**
+ * @brief A command encoded in a CommandArena, its payload (if any) is stored inline in the same arena.
+ */
+struct CommandRecord {
+        CommandRecord *next;
+        void (*apply)(Scene &scene, CommandRecord &record); /**< Typed part of SpawnBundle, Insert, Remove and Custom commands. */
+        void (*apply_batch)(Scene &scene, CommandRecord *const *records, usize count); /**< Applies a run of same-bundle spawns. */
+        void (*drop)(void *payload); /**< Destroys the payload, null when trivially destructible. */
+        void *payload;
+        u64 source; /**< Dispatch index of the system that recorded the command, see CommandBuffer::set_source. */
+        Entity entity;
+        Entity target; /**< Second entity of AddChild commands. */
+        CommandOp op;
+};
+
 /**
  * @brief A buffer that stores commands to be applied to the Scene later.
  * @details This decouples structural ECS changes (spawning, despawning, adding/removing components)
@@ -85,7 +158,14 @@ class R_ENGINE_API EntityCommands
 class R_ENGINE_API CommandBuffer
 {
     public:
-        CommandBuffer() = default;
+        /**
+         * @param scene The scene entity IDs are reserved from when spawning, must not be null to spawn entities.
+         */
+        explicit CommandBuffer(Scene *scene) noexcept;
+        ~CommandBuffer();
+
+        CommandBuffer(const CommandBuffer &) = delete;
+        CommandBuffer &operator=(const CommandBuffer &) = delete;
 
         /**
          * @brief Applies all buffered commands to the scene and clears the buffer.
@@ -93,6 +173,29 @@ class R_ENGINE_API CommandBuffer
          */
         void apply(Scene &scene);
 
+        /**
+         * @brief Applies the commands of several buffers in a deterministic order and clears them.
+         * @details Commands are ordered by source, then by recording order. The buffer a system wrote to
+         * does not matter, so the result is the same whichever thread ran which system.
+         * Runs of consecutive spawns of the same bundle type are applied with a single Scene::spawn_batch.
+         * @param scene The scene to apply commands to.
+         * @param main The buffer of main thread systems.
+         * @param others The thread local buffers of parallel systems.
+         */
+        static void apply_merged(Scene &scene, CommandBuffer &main, const std::vector<std::unique_ptr<CommandBuffer>> &others);
+
+        /**
+         * @brief Sets the source of the commands recorded from now on.
+         * @details The scheduler gives every system run a increasing dispatch index and restores the previous
+         * source once the system returned, commands recorded outside of systems keep it (0 by default).
+         */
+        void set_source(u64 source) noexcept;
+
+        /**
+         * @brief Gets the source of the commands recorded from now on.
+         */
+        u64 get_source() const noexcept;
+
         /**
          * @brief Schedules a command to add a component to an entity.
          */
@@ -123,10 +226,31 @@ class R_ENGINE_API CommandBuffer
         void despawn(Entity e);
 
         /**
-         * @brief Generates a placeholder entity and schedules its creation.
+         * @brief Schedules a command to despawn every entity matching With<T> / Without<T> filters, see Scene::despawn_all.
+         */
+        template<typename... Filters>
+        void despawn_all();
+
+        /**
+         * @brief Reserves an entity in the scene and schedules its creation.
+         * @throws r::exception::Error if the buffer is not bound to a scene or if no entity index is left.
          */
         Entity spawn_entity();
 
+        /**
+         * @brief Reserves an entity in the scene and schedules its creation with a bundle of components.
+         * @details The entity is created directly in the archetype of the bundle, see Scene::spawn.
+         * @throws r::exception::Error if the buffer is not bound to a scene or if no entity index is left.
+         */
+        template<typename... Components>
+        Entity spawn_bundle(Components &&...components);
+
+        /**
+         * @brief Schedules the creation of one entity per bundle, see Scene::spawn_batch.
+         */
+        template<typename... Components>
+        void spawn_batch(std::vector<std::tuple<Components...>> bundles);
+
         /**
          * @brief Schedules adding a child to a parent's Children component.
          */
@@ -140,10 +264,33 @@ class R_ENGINE_API CommandBuffer
     private:
         friend struct Commands;
 
-        void _add_command(std::function<void(Scene &)> &&command);
+        Entity _reserve_entity();
+        CommandRecord &_push(CommandOp op, Entity entity, Entity target = NULL_ENTITY);
+        template<typename P, typename... Args>
+        P &_emplace_payload(CommandRecord &record, Args &&...args);
+        template<typename Func>
+        void _push_custom(Func &&func);
+        static void _apply_records(Scene &scene, std::vector<CommandRecord *> &records);
+        static void _apply_record(Scene &scene, CommandRecord &record);
+        void _drop_pending() noexcept;
 
-        std::vector<std::function<void(Scene &)>> _commands;
-        Entity _next_placeholder = (std::numeric_limits<Entity>::max)();
+        template<typename T>
+        static void _apply_insert(Scene &scene, CommandRecord &record);
+        template<typename T>
+        static void _apply_remove(Scene &scene, CommandRecord &record);
+        template<typename... Components>
+        static void _apply_spawn_bundle(Scene &scene, CommandRecord &record);
+        template<typename... Components>
+        static void _apply_spawn_bundles(Scene &scene, CommandRecord *const *records, usize count);
+        template<typename Func>
+        static void _apply_custom(Scene &scene, CommandRecord &record);
+
+        Scene *_scene;
+        CommandArena _arena;
+        CommandRecord *_head = nullptr;
+        CommandRecord *_tail = nullptr;
+        std::vector<CommandRecord *> _merged;
+        u64 _source = 0;
         Commands *_commands_wrapper = nullptr;
 };
 
@@ -159,17 +306,28 @@ struct R_ENGINE_API Commands {
         /**
          * @brief Schedules an entity to be spawned with no initial components.
          * @return An EntityCommands handle to chain further commands like `insert`.
+         * @throws r::exception::Error if no entity index is left, the ID is reserved right away.
          */
-        EntityCommands spawn() noexcept;
+        EntityCommands spawn();
 
         /**
          * @brief Schedules an entity to be spawned with a set of initial components.
          * @details This is the preferred way to create entities with their starting components.
          * @param components The components to insert into the new entity.
          * @return An EntityCommands handle to chain further commands.
+         * @throws r::exception::Error if no entity index is left, the ID is reserved right away.
          */
         template<typename... Components>
-        EntityCommands spawn(Components &&...components) noexcept;
+        EntityCommands spawn(Components &&...components);
+
+        /**
+         * @brief Schedules the creation of one entity per bundle of components.
+         * @details All entities are appended to the archetype of the bundle type in one go, which is much
+         * cheaper than spawning them one by one. No IDs are returned, query the entities afterwards if needed.
+         * @param bundles The components of each new entity.
+         */
+        template<typename... Components>
+        void spawn_batch(std::vector<std::tuple<Components...>> bundles);
 
         /**
          * @brief Returns an EntityCommands handle for an existing entity.
@@ -201,6 +359,14 @@ struct R_ENGINE_API Commands {
          */
         void despawn(Entity e) noexcept;
 
+        /**
+         * @brief Schedules every entity matching the filters to be despawned at once.
+         * @details e.g. commands.despawn_all<With<LevelEntity>>() when leaving a level.
+         * @tparam Filters With<T> and Without<T> filters.
+         */
+        template<typename... Filters>
+        void despawn_all() noexcept;
+
         /**
          * @brief Internal: Add a child to a parent's Children component.
          */
@@ -6,10 +6,50 @@ namespace r {
 
 namespace ecs {
 
+/**
+ * @brief Entity handle, packs a slot index in the low bits and a generation in the high bits.
+ * @details The generation of a slot is bumped every time its entity is destroyed, so handles kept
+ * around after a despawn no longer resolve once the slot is reused.
+ */
 using Entity = u32;
 
+static constexpr u32 ENTITY_INDEX_BITS = 22;
+static constexpr u32 ENTITY_GENERATION_BITS = 32 - ENTITY_INDEX_BITS;
+static constexpr u32 ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1u;
+
+/**
+ * @brief Largest generation given to a live entity.
+ * @details The highest generation is never used by the scene, which keeps NULL_ENTITY out of the range
+ * of real handles.
+ */
+static constexpr u32 MAX_ENTITY_GENERATION = (1u << ENTITY_GENERATION_BITS) - 2u;
+
 static constexpr Entity NULL_ENTITY = static_cast<Entity>(-1);
 
+/**
+ * @brief Gets the slot index of an entity handle.
+ */
+constexpr u32 entity_index(Entity e) noexcept
+{
+    return e & ENTITY_INDEX_MASK;
+}
+
+/**
+ * @brief Gets the generation of an entity handle.
+ */
+constexpr u32 entity_generation(Entity e) noexcept
+{
+    return e >> ENTITY_INDEX_BITS;
+}
+
+/**
+ * @brief Builds an entity handle from a slot index and a generation.
+ */
+constexpr Entity make_entity(u32 index, u32 generation) noexcept
+{
+    return (generation << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+}
+
 }// namespace ecs
 
 }// namespace r
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <R-Engine/R-EngineExport.hpp>
 #include <R-Engine/Types.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
 #include <vector>
 
 namespace r {
@@ -14,28 +22,156 @@ class EventWriter;
 template<typename EventT>
 class EventReader;
 
+/**
+ * @brief Number of append segments of an Events<T> channel.
+ */
+inline constexpr usize EVENT_SEGMENTS = 16;
+
+/**
+ * @brief Gets a small index unique to the calling thread, assigned on first use.
+ * @details Used to spread event writers over the segments of Events<T>.
+ */
+R_ENGINE_API usize current_thread_slot() noexcept;
+
+/**
+ * @brief Gets the send batch of the calling thread, events are merged by (source, batch).
+ * @details The scheduler resets it to 0 for every system run. Query::par_for_each gives each of its
+ * batches the next value, so events sent by one writer from several workers merge in row order
+ * whichever worker ran which batch.
+ */
+R_ENGINE_API u64 &current_event_batch() noexcept;
+
+/**
+ * @brief Gets a new id identifying an Events<T> channel, never 0.
+ */
+R_ENGINE_API u64 next_event_channel() noexcept;
+
+/**
+ * @brief Number of updates an event stays readable when a registered reader has not consumed it yet.
+ */
+inline constexpr usize DEFAULT_EVENT_RETENTION = 4;
+
+/**
+ * @brief Growable ring of events addressed by a monotonic event id.
+ * @details Slots are reused once the oldest events are dropped, the storage only grows when more
+ * events are alive at once than it ever held before.
+ */
+template<typename T>
+class EventRing
+{
+    public:
+        EventRing() noexcept = default;
+        ~EventRing();
+
+        EventRing(const EventRing &) = delete;
+        EventRing &operator=(const EventRing &) = delete;
+        EventRing(EventRing &&other) noexcept;
+        EventRing &operator=(EventRing &&other) noexcept;
+
+        void push_back(T &&value);
+        void pop_front() noexcept;
+
+        const T &operator[](u64 id) const noexcept;
+
+        u64 front_id() const noexcept;
+        u64 end_id() const noexcept;
+
+    private:
+        void _grow();
+        void _release() noexcept;
+
+        T *_data = nullptr;
+        usize _capacity = 0;
+        u64 _head = 0;
+        u64 _tail = 0;
+};
+
+/**
+ * @brief Per-system position of an EventReader<T> parameter.
+ * @details Kept in the system state, channel identifies the Events<T> the cursor was registered to
+ * and next points at the id of the first event the system has not read yet.
+ */
+struct EventCursor {
+        u64 channel = 0;
+        u64 *next = nullptr;
+};
+
 /**
  * @brief Internal storage for events of type EventT.
  * @details This is stored as a resource in the Scene.
- * Uses double buffering to make events from frame N readable in frame N+1.
+ * Events sent in frame N are published by update() at the end of the frame and readable from frame N+1.
+ * A published event is kept until every registered reader has consumed it, or until it went through
+ * `retention` updates. With no registered reader, events are dropped by the next update.
+ * send() is thread safe, so any number of systems holding an EventWriter<EventT> can run in the same
+ * stage. Each thread appends to its own segment, events are tagged with the dispatch source of the
+ * system that sent them and merged by source, like CommandBuffer::apply_merged, so their order does
+ * not depend on which thread ran which system.
  */
 template<typename EventT>
 class Events
 {
     public:
-        Events() = default;
+        explicit Events(usize retention = DEFAULT_EVENT_RETENTION);
 
-        void send(const EventT &event);
-        void send(EventT &&event);
+        /**
+         * @param source the dispatch source of the sending system, see CommandBuffer::set_source.
+         */
+        void send(const EventT &event, u64 source = 0);
+        void send(EventT &&event, u64 source = 0);
 
-        const std::vector<EventT> &get_events() const;
         void update();
         bool has_events() const;
 
+        /**
+         * @brief registers a new reader, its position starts at the events published by the last update.
+         * @return the position of the reader, owned by the channel and stable until it is destroyed.
+         */
+        u64 *register_reader();
+
+        const EventT &get(u64 id) const noexcept;
+
+        /** @brief id of the oldest event still readable. */
+        u64 first_id() const noexcept;
+        /** @brief id of the first event published by the last update. */
+        u64 latest_id() const noexcept;
+        /** @brief one past the id of the newest readable event. */
+        u64 end_id() const noexcept;
+
+        u64 channel_id() const noexcept;
+        usize get_retention() const noexcept;
+        void set_retention(usize retention) noexcept;
+
     private:
-        std::vector<EventT> _a;
-        std::vector<EventT> _b;
-        bool _reading_a = true;
+        /** @brief An event waiting for the next update, with the source and batch it was sent from. */
+        struct Pending {
+                u64 source;
+                u64 batch;
+                EventT event;
+        };
+
+        /** @brief Events sent by the threads mapped to one slot, the flag is only contended past EVENT_SEGMENTS threads. */
+        struct alignas(64) Segment {
+                std::atomic_flag busy;
+                std::vector<Pending> events;
+        };
+
+        /** @brief registration may happen from systems of the same stage, positions live in a deque so they never move. */
+        struct Readers {
+                std::mutex lock;
+                std::deque<u64> positions;
+        };
+
+        template<typename E>
+        void _push(E &&event, u64 source);
+        void _drop_consumed();
+
+        std::unique_ptr<std::array<Segment, EVENT_SEGMENTS>> _segments;
+        std::unique_ptr<Readers> _readers;
+        EventRing<EventT> _ring;
+        std::vector<Pending *> _merged;
+        std::deque<u64> _batches;
+        usize _retention;
+        u64 _channel;
 };
 
 /**
@@ -46,26 +182,34 @@ template<typename EventT>
 class EventWriter final
 {
     public:
+        using EventType = EventT;
+
         EventWriter() noexcept = default;
-        explicit EventWriter(Events<EventT> *events_ptr) noexcept;
+        explicit EventWriter(Events<EventT> *events_ptr, u64 source = 0) noexcept;
 
         void send(const EventT &event);
         void send(EventT &&event);
 
     private:
         Events<EventT> *_events = nullptr;
+        u64 _source = 0;
 };
 
 /**
  * @brief Provides read access to iterate over events of type EventT.
  * @details EventReader is resolved by the Resolver as a wrapper around Events<EventT> resource.
+ * As a system parameter it reads every event published since the previous run of that system,
+ * constructed directly from an Events<EventT> it reads the events published by the last update.
  */
 template<typename EventT>
 class EventReader final
 {
     public:
+        using EventType = EventT;
+
         EventReader() noexcept = default;
         explicit EventReader(const Events<EventT> *events_ptr) noexcept;
+        explicit EventReader(const Events<EventT> *events_ptr, u64 begin, u64 end) noexcept;
 
         bool has_events() const noexcept;
 
@@ -78,7 +222,7 @@ class EventReader final
                 using pointer = const EventT *;
                 using reference = const EventT &;
 
-                Iterator(const std::vector<EventT> *events, u64 idx);
+                Iterator(const Events<EventT> *events, u64 id);
                 reference operator*() const;
                 pointer operator->() const;
 
@@ -89,15 +233,37 @@ class EventReader final
                 bool operator!=(const Iterator &other) const;
 
             private:
-                const std::vector<EventT> *_events;
-                u64 _index;
+                const Events<EventT> *_events;
+                u64 _id;
         };
 
         Iterator begin() const;
         Iterator end() const;
 
     private:
+        u64 _first() const noexcept;
+        u64 _last() const noexcept;
+
         const Events<EventT> *_events = nullptr;
+        u64 _begin = 0;
+        u64 _end = 0;
+        bool _latest = false;
+};
+
+template<typename T>
+struct is_event_writer : std::false_type {
+};
+
+template<typename T>
+struct is_event_writer<EventWriter<T>> : std::true_type {
+};
+
+template<typename T>
+struct is_event_reader : std::false_type {
+};
+
+template<typename T>
+struct is_event_reader<EventReader<T>> : std::true_type {
 };
 
 }// namespace ecs
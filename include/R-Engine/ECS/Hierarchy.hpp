@@ -0,0 +1,131 @@
+#pragma once
+
+#include <R-Engine/ECS/Entity.hpp>
+#include <R-Engine/R-EngineExport.hpp>
+#include <R-Engine/Types.hpp>
+
+#include <vector>
+
+namespace r {
+
+namespace ecs {
+
+/**
+ * @brief Parent/child links of the entities of a Scene, maintained by the engine.
+ * @details Each entity index owns a node with its parent, first child, last child and siblings, so walking
+ * a hierarchy never needs a lookup. The Children and Parent components mirror these links for queries,
+ * the index is the source of truth and is updated by Scene::add_child, Scene::destroy_entity and by
+ * inserting or removing those components, which the Scene routes through the index.
+ * depth_order() lists every entity that has a parent in pre-order, so a parent always comes before
+ * its children and propagating data down the hierarchy is a single linear scan. A subtree is a
+ * contiguous range of it, moving or dropping a subtree splices that range instead of rebuilding.
+ */
+class R_ENGINE_API HierarchyIndex
+{
+    public:
+        /** @brief An entry of depth_order(). */
+        struct Link {
+                Entity entity;
+                Entity parent;
+        };
+
+        HierarchyIndex() = default;
+        ~HierarchyIndex() = default;
+
+        HierarchyIndex(const HierarchyIndex &) = delete;
+        HierarchyIndex &operator=(const HierarchyIndex &) = delete;
+
+        /**
+         * @brief Makes child the last child of parent, detaching it from its previous parent.
+         * @return false if the link would create a cycle, the hierarchy is left unchanged.
+         */
+        bool link(Entity parent, Entity child);
+
+        /**
+         * @brief Detaches an entity from its parent, it becomes a root with its subtree.
+         */
+        void unlink(Entity child) noexcept;
+
+        /**
+         * @brief Drops the node of an entity, its children become roots.
+         */
+        void remove(Entity e) noexcept;
+
+        /**
+         * @brief Drops the nodes of an entity and of all its descendants at once.
+         */
+        void remove_subtree(Entity root) noexcept;
+
+        /**
+         * @brief Checks if an entity has a parent or children.
+         */
+        bool is_linked(Entity e) const noexcept;
+
+        Entity parent(Entity e) const noexcept;
+        Entity first_child(Entity e) const noexcept;
+        Entity next_sibling(Entity e) const noexcept;
+        u32 depth(Entity e) const noexcept;
+
+        /**
+         * @brief Appends an entity and all its descendants to out, every parent before its children.
+         */
+        void collect_descendants(Entity root, std::vector<Entity> &out) const;
+
+        /**
+         * @brief Gets every entity that has a parent with its parent, a parent always before its children.
+         * @details Kept up to date by every link change, reading it never modifies the index.
+         */
+        const std::vector<Link> &depth_order() const noexcept;
+
+    private:
+        static constexpr usize INVALID_ORDER = static_cast<usize>(-1);
+
+        struct Node {
+                Entity self = NULL_ENTITY;
+                Entity parent = NULL_ENTITY;
+                Entity first_child = NULL_ENTITY;
+                Entity last_child = NULL_ENTITY;
+                Entity prev_sibling = NULL_ENTITY;
+                Entity next_sibling = NULL_ENTITY;
+                u32 depth = 0;
+                u32 size = 1;                /**< Nodes of the subtree, this one included. */
+                usize order = INVALID_ORDER; /**< Position in _order, only when the node has a parent. */
+        };
+
+        Node *_find(Entity e) noexcept;
+        const Node *_find(Entity e) const noexcept;
+        Node &_ensure(Entity e);
+        void _detach(Node &node) noexcept;
+        void _resize_ancestors(const Node &node, i64 delta) noexcept;
+        void _set_subtree_depth(Node &root, u32 depth) noexcept;
+        usize _descendants_begin(const Node &node) const noexcept;
+        void _move_range(usize begin, usize count, usize pos) noexcept;
+        void _detach_to_back(Node &node) noexcept;
+
+        std::vector<Node> _nodes; /**< Indexed by entity index. */
+        std::vector<Link> _order; /**< Pre-order of the linked entities, see depth_order(). */
+};
+
+/**
+ * @brief Hierarchy
+ * @info read-only access to the HierarchyIndex of the scene as a system parameter.
+ *
+ * void propagate_system(Hierarchy hierarchy)
+ * {
+ *     for (const auto &[entity, parent] : hierarchy->depth_order()) {
+ *         // parent was visited before entity
+ *     }
+ * }
+ */
+struct Hierarchy {
+        const HierarchyIndex *index = nullptr;
+
+        const HierarchyIndex *operator->() const noexcept
+        {
+            return index;
+        }
+};
+
+}// namespace ecs
+
+}// namespace r
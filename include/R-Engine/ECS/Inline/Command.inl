@@ -25,7 +25,7 @@ inline r::ecs::EntityCommands &r::ecs::EntityCommands::remove() noexcept
 }
 
 template<typename FuncT>
-inline r::ecs::EntityCommands &r::ecs::EntityCommands::with_children(FuncT &&func) noexcept
+inline r::ecs::EntityCommands &r::ecs::EntityCommands::with_children(FuncT &&func)
 {
     if (_buffer) {
         ChildBuilder builder(_buffer->get_commands(), _entity);
@@ -42,37 +42,118 @@ inline r::ecs::EntityCommands &r::ecs::EntityCommands::with_children(FuncT &&fun
 template<typename T>
 inline void r::ecs::CommandBuffer::add_component(Entity e, T component)
 {
-    _add_command([e, component = std::move(component)](Scene &scene) mutable {
-        const auto &map = scene.get_command_buffer_placeholder_map();
-        const auto it = map.find(e);
-        const Entity real_entity = (it != map.end()) ? it->second : e;
+    /* the component type is only registered when the command is applied */
+    CommandRecord &record = _push(CommandOp::Insert, e);
 
-        scene.add_component<T>(real_entity, std::move(component));
-    });
+    record.apply = &CommandBuffer::_apply_insert<T>;
+    _emplace_payload<T>(record, std::move(component));
 }
 
 template<typename T>
 inline void r::ecs::CommandBuffer::remove_component(Entity e)
 {
-    _add_command([e](Scene &scene) {
-        const auto &map = scene.get_command_buffer_placeholder_map();
-        const auto it = map.find(e);
-        const Entity real_entity = (it != map.end()) ? it->second : e;
+    _push(CommandOp::Remove, e).apply = &CommandBuffer::_apply_remove<T>;
+}
+
+template<typename... Components>
+inline r::ecs::Entity r::ecs::CommandBuffer::spawn_bundle(Components &&...components)
+{
+    using Bundle = std::tuple<std::decay_t<Components>...>;
+    const Entity e = _reserve_entity();
+    CommandRecord &record = _push(CommandOp::SpawnBundle, e);
+
+    record.apply = &CommandBuffer::_apply_spawn_bundle<std::decay_t<Components>...>;
+    record.apply_batch = &CommandBuffer::_apply_spawn_bundles<std::decay_t<Components>...>;
+    _emplace_payload<Bundle>(record, std::forward<Components>(components)...);
+
+    return e;
+}
 
-        scene.remove_component<T>(real_entity);
-    });
+template<typename... Components>
+inline void r::ecs::CommandBuffer::spawn_batch(std::vector<std::tuple<Components...>> bundles)
+{
+    _push_custom([bundles = std::move(bundles)](Scene &scene) mutable { scene.spawn_batch(std::move(bundles)); });
 }
 
 template<typename T>
 inline void r::ecs::CommandBuffer::insert_resource(T resource)
 {
-    _add_command([res = std::move(resource)](Scene &scene) mutable { scene.insert_resource(std::move(res)); });
+    _push_custom([res = std::move(resource)](Scene &scene) mutable { scene.insert_resource(std::move(res)); });
 }
 
 template<typename T>
 inline void r::ecs::CommandBuffer::remove_resource()
 {
-    _add_command([](Scene &scene) { scene.remove_resource<T>(); });
+    _push_custom([](Scene &scene) { scene.remove_resource<T>(); });
+}
+
+template<typename... Filters>
+inline void r::ecs::CommandBuffer::despawn_all()
+{
+    _push_custom([](Scene &scene) { scene.despawn_all<Filters...>(); });
+}
+
+template<typename P, typename... Args>
+inline P &r::ecs::CommandBuffer::_emplace_payload(CommandRecord &record, Args &&...args)
+{
+    P *payload = ::new (_arena.allocate(sizeof(P), alignof(P))) P(std::forward<Args>(args)...);
+
+    record.payload = payload;
+    if constexpr (!std::is_trivially_destructible_v<P>) {
+        record.drop = [](void *ptr) { static_cast<P *>(ptr)->~P(); };
+    }
+    return *payload;
+}
+
+template<typename Func>
+inline void r::ecs::CommandBuffer::_push_custom(Func &&func)
+{
+    using F = std::decay_t<Func>;
+    CommandRecord &record = _push(CommandOp::Custom, NULL_ENTITY);
+
+    record.apply = &CommandBuffer::_apply_custom<F>;
+    _emplace_payload<F>(record, std::forward<Func>(func));
+}
+
+template<typename T>
+inline void r::ecs::CommandBuffer::_apply_insert(Scene &scene, CommandRecord &record)
+{
+    scene.add_component<T>(record.entity, std::move(*static_cast<T *>(record.payload)));
+}
+
+template<typename T>
+inline void r::ecs::CommandBuffer::_apply_remove(Scene &scene, CommandRecord &record)
+{
+    scene.remove_component<T>(record.entity);
+}
+
+template<typename... Components>
+inline void r::ecs::CommandBuffer::_apply_spawn_bundle(Scene &scene, CommandRecord &record)
+{
+    auto &bundle = *static_cast<std::tuple<Components...> *>(record.payload);
+
+    std::apply([&scene, &record](auto &...comps) { scene.spawn_reserved(record.entity, std::move(comps)...); }, bundle);
+}
+
+template<typename... Components>
+inline void r::ecs::CommandBuffer::_apply_spawn_bundles(Scene &scene, CommandRecord *const *records, usize count)
+{
+    std::vector<Entity> entities;
+    std::vector<std::tuple<Components...>> bundles;
+
+    entities.reserve(count);
+    bundles.reserve(count);
+    for (usize i = 0; i < count; ++i) {
+        entities.push_back(records[i]->entity);
+        bundles.push_back(std::move(*static_cast<std::tuple<Components...> *>(records[i]->payload)));
+    }
+    scene.spawn_batch_reserved(entities, std::move(bundles));
+}
+
+template<typename Func>
+inline void r::ecs::CommandBuffer::_apply_custom(Scene &scene, CommandRecord &record)
+{
+    (*static_cast<Func *>(record.payload))(scene);
 }
 
 /**
@@ -80,12 +161,19 @@ inline void r::ecs::CommandBuffer::remove_resource()
  */
 
 template<typename... Components>
-inline r::ecs::EntityCommands r::ecs::Commands::spawn(Components &&...components) noexcept
+inline r::ecs::EntityCommands r::ecs::Commands::spawn(Components &&...components)
 {
-    EntityCommands entity_cmds = this->spawn();
+    const Entity e = _buffer ? _buffer->spawn_bundle(std::forward<Components>(components)...) : 0;
 
-    (entity_cmds.insert(std::forward<Components>(components)), ...);
-    return entity_cmds;
+    return EntityCommands(_buffer, e);
+}
+
+template<typename... Components>
+inline void r::ecs::Commands::spawn_batch(std::vector<std::tuple<Components...>> bundles)
+{
+    if (_buffer) {
+        _buffer->spawn_batch(std::move(bundles));
+    }
 }
 
 template<typename T>
@@ -104,6 +192,14 @@ inline void r::ecs::Commands::remove_resource() noexcept
     }
 }
 
+template<typename... Filters>
+inline void r::ecs::Commands::despawn_all() noexcept
+{
+    if (_buffer) {
+        _buffer->template despawn_all<Filters...>();
+    }
+}
+
 /**
  * ChildBuilder
  */
@@ -114,11 +210,10 @@ inline r::ecs::ChildBuilder::ChildBuilder(r::ecs::Commands *commands, r::ecs::En
 }
 
 template<typename... Components>
-inline r::ecs::EntityCommands r::ecs::ChildBuilder::spawn(Components &&...components) noexcept
+inline r::ecs::EntityCommands r::ecs::ChildBuilder::spawn(Components &&...components)
 {
-    auto child = _commands->spawn(std::forward<Components>(components)...);
+    auto child = _commands->spawn(std::forward<Components>(components)..., Parent{_parent});
 
-    child.insert(Parent{_parent});
     _commands->add_child(_parent, child.id());
     return child;
 }
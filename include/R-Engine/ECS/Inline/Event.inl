@@ -2,54 +2,249 @@
 
 #include "R-Engine/ECS/Event.hpp"
 
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+/**
+* EventRing
+*/
+
+template<typename T>
+r::ecs::EventRing<T>::~EventRing()
+{
+    _release();
+}
+
+template<typename T>
+r::ecs::EventRing<T>::EventRing(EventRing &&other) noexcept
+    : _data(std::exchange(other._data, nullptr)), _capacity(std::exchange(other._capacity, 0)), _head(other._head), _tail(other._tail)
+{
+    other._head = other._tail;
+}
+
+template<typename T>
+r::ecs::EventRing<T> &r::ecs::EventRing<T>::operator=(EventRing &&other) noexcept
+{
+    if (this != &other) {
+        _release();
+        _data = std::exchange(other._data, nullptr);
+        _capacity = std::exchange(other._capacity, 0);
+        _head = other._head;
+        _tail = other._tail;
+        other._head = other._tail;
+    }
+    return *this;
+}
+
+template<typename T>
+void r::ecs::EventRing<T>::push_back(T &&value)
+{
+    if (_tail - _head == _capacity) {
+        _grow();
+    }
+    std::construct_at(_data + (_tail & (_capacity - 1)), std::move(value));
+    ++_tail;
+}
+
+template<typename T>
+void r::ecs::EventRing<T>::pop_front() noexcept
+{
+    std::destroy_at(_data + (_head & (_capacity - 1)));
+    ++_head;
+}
+
+template<typename T>
+const T &r::ecs::EventRing<T>::operator[](u64 id) const noexcept
+{
+    return _data[id & (_capacity - 1)];
+}
+
+template<typename T>
+u64 r::ecs::EventRing<T>::front_id() const noexcept
+{
+    return _head;
+}
+
+template<typename T>
+u64 r::ecs::EventRing<T>::end_id() const noexcept
+{
+    return _tail;
+}
+
+template<typename T>
+void r::ecs::EventRing<T>::_grow()
+{
+    /* power of two capacity, so an id maps to its slot with a mask */
+    const usize capacity = _capacity ? _capacity * 2 : 16;
+    std::allocator<T> allocator;
+    T *data = allocator.allocate(capacity);
+
+    for (u64 id = _head; id < _tail; ++id) {
+        T &old = _data[id & (_capacity - 1)];
+
+        std::construct_at(data + (id & (capacity - 1)), std::move(old));
+        std::destroy_at(&old);
+    }
+    if (_data) {
+        allocator.deallocate(_data, _capacity);
+    }
+    _data = data;
+    _capacity = capacity;
+}
+
+template<typename T>
+void r::ecs::EventRing<T>::_release() noexcept
+{
+    while (_head != _tail) {
+        pop_front();
+    }
+    if (_data) {
+        std::allocator<T>().deallocate(_data, _capacity);
+        _data = nullptr;
+        _capacity = 0;
+    }
+}
+
 /**
 * Events
 */
 
 template<typename EventT>
-void r::ecs::Events<EventT>::send(const EventT &event)
+r::ecs::Events<EventT>::Events(usize retention)
+    : _segments(std::make_unique<std::array<Segment, EVENT_SEGMENTS>>()), _readers(std::make_unique<Readers>()),
+      _retention(retention ? retention : 1), _channel(next_event_channel())
 {
-    if (_reading_a) {
-        _b.push_back(event);
-    } else {
-        _a.push_back(event);
-    }
+    /* __ctor__ */
 }
 
 template<typename EventT>
-void r::ecs::Events<EventT>::send(EventT &&event)
+void r::ecs::Events<EventT>::send(const EventT &event, u64 source)
 {
-    if (_reading_a) {
-        _b.push_back(std::move(event));
-    } else {
-        _a.push_back(std::move(event));
-    }
+    _push(event, source);
 }
 
 template<typename EventT>
-const std::vector<EventT> &r::ecs::Events<EventT>::get_events() const
+void r::ecs::Events<EventT>::send(EventT &&event, u64 source)
 {
-    return _reading_a ? _a : _b;
+    _push(std::move(event), source);
 }
 
 template<typename EventT>
 void r::ecs::Events<EventT>::update()
 {
-    /* Swap which buffer is for reading and which is for writing. */
-    _reading_a = !_reading_a;
+    _drop_consumed();
+    _batches.push_back(_ring.end_id());
+    if (_batches.size() > _retention) {
+        _batches.pop_front();
+    }
+    _merged.clear();
+    for (Segment &segment : *_segments) {
+        for (Pending &pending : segment.events) {
+            _merged.push_back(&pending);
+        }
+    }
 
-    /* Clear the new write buffer. */
-    if (_reading_a) { /* We are now reading from A, so B is the write buffer. */
-        _b.clear();
-    } else { /* We are now reading from B, so A is the write buffer. */
-        _a.clear();
+    /* a (source, batch) pair only ever sends from one thread, so the stable sort keeps its sending order */
+    std::stable_sort(_merged.begin(), _merged.end(),
+        [](const Pending *a, const Pending *b) { return a->source != b->source ? a->source < b->source : a->batch < b->batch; });
+    for (Pending *pending : _merged) {
+        _ring.push_back(std::move(pending->event));
+    }
+    _merged.clear();
+    for (Segment &segment : *_segments) {
+        segment.events.clear();
     }
 }
 
 template<typename EventT>
 bool r::ecs::Events<EventT>::has_events() const
 {
-    return _reading_a ? !_a.empty() : !_b.empty();
+    return latest_id() != end_id();
+}
+
+template<typename EventT>
+u64 *r::ecs::Events<EventT>::register_reader()
+{
+    std::scoped_lock lock(_readers->lock);
+
+    return &_readers->positions.emplace_back(latest_id());
+}
+
+template<typename EventT>
+const EventT &r::ecs::Events<EventT>::get(u64 id) const noexcept
+{
+    return _ring[id];
+}
+
+template<typename EventT>
+u64 r::ecs::Events<EventT>::first_id() const noexcept
+{
+    return _ring.front_id();
+}
+
+template<typename EventT>
+u64 r::ecs::Events<EventT>::latest_id() const noexcept
+{
+    return _batches.empty() ? _ring.end_id() : _batches.back();
+}
+
+template<typename EventT>
+u64 r::ecs::Events<EventT>::end_id() const noexcept
+{
+    return _ring.end_id();
+}
+
+template<typename EventT>
+u64 r::ecs::Events<EventT>::channel_id() const noexcept
+{
+    return _channel;
+}
+
+template<typename EventT>
+usize r::ecs::Events<EventT>::get_retention() const noexcept
+{
+    return _retention;
+}
+
+template<typename EventT>
+void r::ecs::Events<EventT>::set_retention(usize retention) noexcept
+{
+    _retention = retention ? retention : 1;
+    while (_batches.size() > _retention) {
+        _batches.pop_front();
+    }
+}
+
+template<typename EventT>
+template<typename E>
+void r::ecs::Events<EventT>::_push(E &&event, u64 source)
+{
+    Segment &segment = (*_segments)[current_thread_slot() % EVENT_SEGMENTS];
+
+    while (segment.busy.test_and_set(std::memory_order_acquire)) {
+        segment.busy.wait(true, std::memory_order_relaxed);
+    }
+    segment.events.push_back(Pending{source, current_event_batch(), std::forward<E>(event)});
+    segment.busy.clear(std::memory_order_release);
+    segment.busy.notify_one();
+}
+
+template<typename EventT>
+void r::ecs::Events<EventT>::_drop_consumed()
+{
+    /* runs before the new batch is published, so the oldest batch left in _batches is about to expire */
+    u64 keep_from = _ring.end_id();
+
+    for (const u64 position : _readers->positions) {
+        keep_from = (std::min)(keep_from, position);
+    }
+    if (_batches.size() == _retention) {
+        keep_from = (std::max)(keep_from, _batches.size() > 1 ? _batches[1] : _ring.end_id());
+    }
+    while (_ring.front_id() < keep_from) {
+        _ring.pop_front();
+    }
 }
 
 /**
@@ -57,7 +252,7 @@ bool r::ecs::Events<EventT>::has_events() const
 */
 
 template<typename EventT>
-r::ecs::EventWriter<EventT>::EventWriter(r::ecs::Events<EventT> *events_ptr) noexcept : _events(events_ptr)
+r::ecs::EventWriter<EventT>::EventWriter(r::ecs::Events<EventT> *events_ptr, u64 source) noexcept : _events(events_ptr), _source(source)
 {
     /* __ctor__ */
 }
@@ -66,7 +261,7 @@ template<typename EventT>
 void r::ecs::EventWriter<EventT>::send(const EventT &event)
 {
     if (_events) {
-        _events->send(event);
+        _events->send(event, _source);
     }
 }
 
@@ -74,7 +269,7 @@ template<typename EventT>
 void r::ecs::EventWriter<EventT>::send(EventT &&event)
 {
     if (_events) {
-        _events->send(std::move(event));
+        _events->send(std::move(event), _source);
     }
 }
 
@@ -83,7 +278,15 @@ void r::ecs::EventWriter<EventT>::send(EventT &&event)
 */
 
 template<typename EventT>
-r::ecs::EventReader<EventT>::EventReader(const r::ecs::Events<EventT> *events_ptr) noexcept : _events(events_ptr)
+r::ecs::EventReader<EventT>::EventReader(const r::ecs::Events<EventT> *events_ptr) noexcept
+    : _events(events_ptr), _latest(true)
+{
+    /* __ctor__ */
+}
+
+template<typename EventT>
+r::ecs::EventReader<EventT>::EventReader(const r::ecs::Events<EventT> *events_ptr, u64 begin, u64 end) noexcept
+    : _events(events_ptr), _begin(begin), _end(end)
 {
     /* __ctor__ */
 }
@@ -91,7 +294,7 @@ r::ecs::EventReader<EventT>::EventReader(const r::ecs::Events<EventT> *events_pt
 template<typename EventT>
 bool r::ecs::EventReader<EventT>::has_events() const noexcept
 {
-    return _events && _events->has_events();
+    return _first() != _last();
 }
 
 /**
@@ -99,7 +302,7 @@ bool r::ecs::EventReader<EventT>::has_events() const noexcept
 */
 
 template<typename EventT>
-r::ecs::EventReader<EventT>::Iterator::Iterator(const std::vector<EventT> *events, u64 idx) : _events(events), _index(idx)
+r::ecs::EventReader<EventT>::Iterator::Iterator(const Events<EventT> *events, u64 id) : _events(events), _id(id)
 {
     /* __ctor__ */
 }
@@ -107,19 +310,19 @@ r::ecs::EventReader<EventT>::Iterator::Iterator(const std::vector<EventT> *event
 template<typename EventT>
 typename r::ecs::EventReader<EventT>::Iterator::reference r::ecs::EventReader<EventT>::Iterator::operator*() const
 {
-    return (*_events)[_index];
+    return _events->get(_id);
 }
 
 template<typename EventT>
 typename r::ecs::EventReader<EventT>::Iterator::pointer r::ecs::EventReader<EventT>::Iterator::operator->() const
 {
-    return &(*_events)[_index];
+    return &_events->get(_id);
 }
 
 template<typename EventT>
 typename r::ecs::EventReader<EventT>::Iterator &r::ecs::EventReader<EventT>::Iterator::operator++()
 {
-    ++_index;
+    ++_id;
     return *this;
 }
 
@@ -128,36 +331,48 @@ typename r::ecs::EventReader<EventT>::Iterator r::ecs::EventReader<EventT>::Iter
 {
     Iterator tmp = *this;
 
-    ++_index;
+    ++_id;
     return tmp;
 }
 
 template<typename EventT>
 bool r::ecs::EventReader<EventT>::Iterator::operator==(const Iterator &other) const
 {
-    return _index == other._index;
+    return _id == other._id;
 }
 
 template<typename EventT>
 bool r::ecs::EventReader<EventT>::Iterator::operator!=(const Iterator &other) const
 {
-    return _index != other._index;
+    return _id != other._id;
 }
 
 template<typename EventT>
 typename r::ecs::EventReader<EventT>::Iterator r::ecs::EventReader<EventT>::begin() const
 {
-    if (!_events) {
-        return Iterator(nullptr, 0);
-    }
-    return Iterator(&_events->get_events(), 0);
+    return Iterator(_events, _first());
 }
 
 template<typename EventT>
 typename r::ecs::EventReader<EventT>::Iterator r::ecs::EventReader<EventT>::end() const
 {
-    if (!_events) {
-        return Iterator(nullptr, 0);
+    return Iterator(_events, _last());
+}
+
+template<typename EventT>
+u64 r::ecs::EventReader<EventT>::_first() const noexcept
+{
+    if (_latest) {
+        return _events ? _events->latest_id() : 0;
+    }
+    return _begin;
+}
+
+template<typename EventT>
+u64 r::ecs::EventReader<EventT>::_last() const noexcept
+{
+    if (_latest) {
+        return _events ? _events->end_id() : 0;
     }
-    return Iterator(&_events->get_events(), _events->get_events().size());
+    return _end;
 }
@@ -5,15 +5,203 @@
  */
 
 template<typename... Wrappers>
-r::ecs::Query<Wrappers...>::Query(Scene *scene, std::vector<Entity> entities) : _scene(scene), _entities(std::move(entities))
+r::ecs::Query<Wrappers...>::Query(Scene *scene, std::vector<Chunk> chunks, u32 last_run, u32 this_run)
+    : _scene(scene), _chunks(std::move(chunks)), _last_run(last_run), _this_run(this_run), _sparse{_sparse_of<Wrappers>(scene)...}
 {
-    /* __ctor__ */
+    for (const auto &chunk : _chunks) {
+        _size += chunk.count;
+    }
 }
 
 template<typename... Wrappers>
 u64 r::ecs::Query<Wrappers...>::size() const
 {
-    return static_cast<u64>(_entities.size());
+    if constexpr (has_row_filters) {
+        u64 count = 0;
+
+        for (const auto &chunk : _chunks) {
+            for (usize row = 0; row < chunk.count; ++row) {
+                count += _row_matches(chunk, row);
+            }
+        }
+        return count;
+    } else {
+        return _size;
+    }
+}
+
+template<typename... Wrappers>
+typename r::ecs::Query<Wrappers...>::Chunk r::ecs::Query<Wrappers...>::make_chunk(const Archetype &archetype)
+{
+    return Chunk{archetype.table.entities.data(), archetype.table.entities.size(), {_column_of<Wrappers>(archetype)...},
+        {_ticks_of<Wrappers>(archetype)...}};
+}
+
+template<typename... Wrappers>
+template<typename W>
+void *r::ecs::Query<Wrappers...>::_column_of(const Archetype &archetype)
+{
+    if constexpr (is_sparse_wrapper_v<W>) {
+        return nullptr;
+    } else if constexpr (is_mut<W>::value || is_ref<W>::value || is_optional<W>::value) {
+        using Comp = typename component_of<W>::type;
+        const u32 col_idx = archetype.column_index(component_id<Comp>());
+
+        if (col_idx == INVALID_INDEX || archetype.table.entities.empty()) {
+            return nullptr;
+        }
+        return archetype.table.columns[col_idx].get_ptr(0);
+    } else {
+        return nullptr;
+    }
+}
+
+template<typename... Wrappers>
+template<typename W>
+u32 *r::ecs::Query<Wrappers...>::_ticks_of(const Archetype &archetype)
+{
+    if constexpr (is_sparse_wrapper_v<W>) {
+        return nullptr;
+    } else if constexpr (is_mut<W>::value || is_added<W>::value || is_changed<W>::value) {
+        using Comp = typename component_of<W>::type;
+        const u32 col_idx = archetype.column_index(component_id<Comp>());
+
+        if (col_idx == INVALID_INDEX) {
+            return nullptr;
+        }
+        const Column &column = archetype.table.columns[col_idx];
+        return is_added<W>::value ? column.added_ticks() : column.changed_ticks();
+    } else {
+        return nullptr;
+    }
+}
+
+template<typename... Wrappers>
+template<typename W>
+const r::ecs::SparseSet *r::ecs::Query<Wrappers...>::_sparse_of(const Scene *scene)
+{
+    if constexpr (is_sparse_wrapper_v<W>) {
+        return scene ? scene->get_sparse_set(component_id<typename component_of<W>::type>()) : nullptr;
+    } else {
+        return nullptr;
+    }
+}
+
+template<typename... Wrappers>
+template<size_t I>
+auto r::ecs::Query<Wrappers...>::_wrapper_at(const Chunk &chunk, usize row) const
+{
+    using W = std::tuple_element_t<I, std::tuple<Wrappers...>>;
+
+    if constexpr (is_sparse_wrapper_v<W>) {
+        const SparseSet *set = _sparse[I];
+        const u32 slot = set ? set->dense_index(chunk.entities[row]) : INVALID_INDEX;
+
+        if (slot == INVALID_INDEX) {
+            /* only reachable for Optional<T> and Without<T>, other wrappers filter the row out */
+            return Iterator::template build_wrapper<W>(nullptr, nullptr, 0, _this_run);
+        }
+        const Column &column = set->column();
+        return Iterator::template build_wrapper<W>(column.get_ptr(0), is_added<W>::value ? column.added_ticks() : column.changed_ticks(),
+            slot, _this_run);
+    } else {
+        return Iterator::template build_wrapper<W>(chunk.columns[I], chunk.ticks[I], row, _this_run);
+    }
+}
+
+template<typename... Wrappers>
+bool r::ecs::Query<Wrappers...>::_row_matches(const Chunk &chunk, usize row) const
+{
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+        return (
+            [&] {
+                if constexpr (is_sparse_wrapper_v<Wrappers> && is_without<Wrappers>::value) {
+                    return !_sparse[I] || !_sparse[I]->contains(chunk.entities[row]);
+                } else if constexpr (is_sparse_wrapper_v<Wrappers> && !is_optional<Wrappers>::value) {
+                    const u32 slot = _sparse[I] ? _sparse[I]->dense_index(chunk.entities[row]) : INVALID_INDEX;
+
+                    if (slot == INVALID_INDEX) {
+                        return false;
+                    }
+                    if constexpr (is_added<Wrappers>::value) {
+                        return is_tick_newer(_sparse[I]->column().added_ticks()[slot], _last_run, _this_run);
+                    } else if constexpr (is_changed<Wrappers>::value) {
+                        return is_tick_newer(_sparse[I]->column().changed_ticks()[slot], _last_run, _this_run);
+                    } else {
+                        return true;
+                    }
+                } else if constexpr (is_added<Wrappers>::value || is_changed<Wrappers>::value) {
+                    return is_tick_newer(chunk.ticks[I][row], _last_run, _this_run);
+                } else {
+                    return true;
+                }
+            }()
+            && ...);
+    }(std::index_sequence_for<Wrappers...>{});
+}
+
+template<typename... Wrappers>
+template<size_t... I>
+void r::ecs::Query<Wrappers...>::_run_rows(const Chunk &chunk, usize begin, usize end, auto &func, std::index_sequence<I...>) const
+{
+    for (usize row = begin; row < end; ++row) {
+        if constexpr (has_row_filters) {
+            if (!_row_matches(chunk, row)) {
+                continue;
+            }
+        }
+        func(_wrapper_at<I>(chunk, row)...);
+    }
+}
+
+template<typename... Wrappers>
+template<typename Func>
+void r::ecs::Query<Wrappers...>::for_each(Func &&func) const
+{
+    for (const auto &chunk : _chunks) {
+        _run_rows(chunk, 0, chunk.count, func, std::index_sequence_for<Wrappers...>{});
+    }
+}
+
+template<typename... Wrappers>
+template<typename Func>
+void r::ecs::Query<Wrappers...>::par_for_each(usize batch_size, Func &&func) const
+{
+    struct Batch {
+            const Chunk *chunk;
+            usize begin;
+            usize end;
+    };
+
+    core::ThreadPool *pool = _scene ? _scene->get_thread_pool() : nullptr;
+    u64 &event_batch = current_event_batch();
+    const u64 first_batch = event_batch + 1;
+    batch_size = batch_size > 0 ? batch_size : 1;
+
+    /* events sent from the rows merge between those sent before and after, in the same order either way */
+    if (!pool || pool->size() == 0 || _size <= batch_size) {
+        event_batch = first_batch;
+        for_each(std::forward<Func>(func));
+        event_batch = first_batch + 1;
+        return;
+    }
+
+    std::vector<Batch> batches;
+    batches.reserve(static_cast<usize>(_size / batch_size) + _chunks.size());
+    for (const auto &chunk : _chunks) {
+        for (usize begin = 0; begin < chunk.count; begin += batch_size) {
+            batches.push_back({&chunk, begin, (std::min)(begin + batch_size, chunk.count)});
+        }
+    }
+
+    pool->parallel_for(batches.size(), [this, &batches, &func, first_batch](size_t index) {
+        const Batch &batch = batches[index];
+        const u64 previous_batch = std::exchange(current_event_batch(), first_batch + index);
+
+        _run_rows(*batch.chunk, batch.begin, batch.end, func, std::index_sequence_for<Wrappers...>{});
+        current_event_batch() = previous_batch;
+    });
+    event_batch = first_batch + batches.size();
 }
 
 /**
@@ -21,59 +209,92 @@ u64 r::ecs::Query<Wrappers...>::size() const
  */
 
 template<typename... Wrappers>
-r::ecs::Query<Wrappers...>::Iterator::Iterator(Scene *scene, const std::vector<Entity> *list, u64 i) : _scene(scene), _list(list), _idx(i)
+r::ecs::Query<Wrappers...>::Iterator::Iterator(const Query *query, usize chunk, usize row) : _query(query), _chunk(chunk), _row(row)
 {
-    /* __ctor__ */
+    _skip_unmatched();
 }
 
 template<typename... Wrappers>
 bool r::ecs::Query<Wrappers...>::Iterator::operator!=(const Iterator &other) const
 {
-    return _idx != other._idx;
+    return _chunk != other._chunk || _row != other._row;
 }
 
 template<typename... Wrappers>
 bool r::ecs::Query<Wrappers...>::Iterator::operator==(const Iterator &other) const
 {
-    return _idx == other._idx;
+    return _chunk == other._chunk && _row == other._row;
 }
 
 template<typename... Wrappers>
 void r::ecs::Query<Wrappers...>::Iterator::operator++()
 {
-    ++_idx;
+    ++_row;
+    _skip_unmatched();
+}
+
+template<typename... Wrappers>
+void r::ecs::Query<Wrappers...>::Iterator::_skip_unmatched()
+{
+    const auto &chunks = _query->_chunks;
+
+    while (_chunk < chunks.size()) {
+        if (_row >= chunks[_chunk].count) {
+            ++_chunk;
+            _row = 0;
+            continue;
+        }
+        if constexpr (has_row_filters) {
+            if (!_query->_row_matches(chunks[_chunk], _row)) {
+                ++_row;
+                continue;
+            }
+        }
+        return;
+    }
 }
 
 template<typename... Wrappers>
 auto r::ecs::Query<Wrappers...>::Iterator::operator*() const
 {
-    Entity e = (*_list)[_idx];
-    return std::tuple<Wrappers...>{build_wrapper<Wrappers>(_scene, e)...};
+    return _build_row(std::index_sequence_for<Wrappers...>{});
+}
+
+template<typename... Wrappers>
+template<size_t... I>
+auto r::ecs::Query<Wrappers...>::Iterator::_build_row(std::index_sequence<I...>) const
+{
+    const Chunk &chunk = _query->_chunks[_chunk];
+
+    return std::tuple<Wrappers...>{_query->template _wrapper_at<I>(chunk, _row)...};
 }
 
 template<typename... Wrappers>
 r::ecs::Entity r::ecs::Query<Wrappers...>::Iterator::entity() const
 {
-    return (*_list)[_idx];
+    return _query->_chunks[_chunk].entities[_row];
 }
 
 template<typename... Wrappers>
 template<typename W>
-W r::ecs::Query<Wrappers...>::Iterator::build_wrapper(Scene *scene, Entity e)
+W r::ecs::Query<Wrappers...>::Iterator::build_wrapper(void *column, u32 *ticks, usize row, u32 this_run)
 {
     if constexpr (is_mut<W>::value) {
         using Comp = typename component_of<W>::type;
-        return W{scene->get_component_ptr<Comp>(e)};
+        /* the pointer is public, so the row is marked as changed as soon as it is handed out */
+        ticks[row] = this_run;
+        return W{static_cast<Comp *>(column) + row};
     } else if constexpr (is_ref<W>::value) {
         using Comp = typename component_of<W>::type;
-        return W{scene->get_component_ptr<Comp>(e)};
+        return W{static_cast<Comp *>(column) + row};
     } else if constexpr (is_optional<W>::value) {
         using Comp = typename component_of<W>::type;
-        return W{scene->get_component_ptr<Comp>(e)};
-    } else if constexpr (is_with<W>::value || is_without<W>::value) {
+        return W{column ? static_cast<Comp *>(column) + row : nullptr};
+    } else if constexpr (is_with<W>::value || is_without<W>::value || is_added<W>::value || is_changed<W>::value) {
         return W{};
     } else {
-        static_assert(!sizeof(W), "r::ecs::Query wrappers must be Mut<T>, Ref<T>, With<T>, Without<T>, or Optional<T>");
+        static_assert(!sizeof(W),
+            "r::ecs::Query wrappers must be Mut<T>, Ref<T>, With<T>, Without<T>, Optional<T>, Added<T>, or Changed<T>");
     }
 }
 
@@ -84,11 +305,11 @@ W r::ecs::Query<Wrappers...>::Iterator::build_wrapper(Scene *scene, Entity e)
 template<typename... Wrappers>
 typename r::ecs::Query<Wrappers...>::Iterator r::ecs::Query<Wrappers...>::begin() const
 {
-    return Iterator(_scene, &_entities, 0);
+    return Iterator(this, 0, 0);
 }
 
 template<typename... Wrappers>
 typename r::ecs::Query<Wrappers...>::Iterator r::ecs::Query<Wrappers...>::end() const
 {
-    return Iterator(_scene, &_entities, _entities.size());
+    return Iterator(this, _chunks.size(), 0);
 }
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "R-Engine/ECS/Resolver.hpp"
-#include <typeindex>
 
 template<typename T>
 r::ecs::Res<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Res<T>>)
@@ -12,6 +11,15 @@ r::ecs::Res<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Res<T>>)
     return r;
 }
 
+template<typename T>
+r::ecs::Res<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Res<T>>, ResourceState &state)
+{
+    r::ecs::Res<T> r;
+
+    r.ptr = _cached_resource<T>(state);
+    return r;
+}
+
 /**
  * ResMut<T>
  */
@@ -24,6 +32,15 @@ r::ecs::ResMut<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::ResMut<T>
     return r;
 }
 
+template<typename T>
+r::ecs::ResMut<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::ResMut<T>>, ResourceState &state)
+{
+    r::ecs::ResMut<T> r;
+
+    r.ptr = _cached_resource<T>(state);
+    return r;
+}
+
 /**
  * EventWriter<T>
  */
@@ -32,7 +49,13 @@ r::ecs::EventWriter<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Even
 {
     auto *events = _scene->get_resource_ptr<Events<T>>();
 
-    return EventWriter<T>(events);
+    return EventWriter<T>(events, _cmd_buffer ? _cmd_buffer->get_source() : 0);
+}
+
+template<typename T>
+r::ecs::EventWriter<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::EventWriter<T>>, ResourceState &state)
+{
+    return EventWriter<T>(_cached_resource<Events<T>>(state), _cmd_buffer ? _cmd_buffer->get_source() : 0);
 }
 
 /**
@@ -46,48 +69,88 @@ r::ecs::EventReader<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Even
     return EventReader<T>(events);
 }
 
+template<typename T>
+r::ecs::EventReader<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::EventReader<T>>, EventCursor &cursor)
+{
+    return _read_events(_scene->get_resource_ptr<Events<T>>(), cursor);
+}
+
+template<typename T>
+r::ecs::EventReader<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::EventReader<T>>, EventReaderState &state)
+{
+    return _read_events(_cached_resource<Events<T>>(state.events), state.cursor);
+}
+
+template<typename T>
+r::ecs::EventReader<T> r::ecs::Resolver::_read_events(Events<T> *events, EventCursor &cursor)
+{
+    if (!events) {
+        return EventReader<T>();
+    }
+    if (cursor.channel != events->channel_id()) {
+        cursor.channel = events->channel_id();
+        cursor.next = events->register_reader();
+    }
+
+    const u64 begin = (std::max)(*cursor.next, events->first_id());
+    const u64 end = events->end_id();
+
+    *cursor.next = end;
+    return EventReader<T>(events, begin, end);
+}
+
+template<typename T>
+T *r::ecs::Resolver::_cached_resource(ResourceState &state)
+{
+    const u64 generation = _scene->get_resource_generation();
+
+    if (state.resource_generation != generation) {
+        state.ptr = _scene->get_resource_ptr<T>();
+        state.resource_generation = generation;
+    }
+    return static_cast<T *>(state.ptr);
+}
+
+/**
+ * RemovedComponents<T>
+ */
+template<typename T>
+r::ecs::RemovedComponents<T> r::ecs::Resolver::resolve(std::type_identity<r::ecs::RemovedComponents<T>>)
+{
+    return RemovedComponents<T>{&_scene->get_removed_components<T>()};
+}
+
 /**
  * Query<Wrappers...>
  */
 template<typename... Wrappers>
 r::ecs::Resolver::Q<Wrappers...> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Query<Wrappers...>>)
 {
-    std::vector<Entity> result_entities;
-    const auto &archetypes = _scene->get_archetypes();
+    QueryState state;
 
-    std::vector<std::type_index> required_types;
-    std::vector<std::type_index> excluded_types;
-    (this->_collect_component_types<Wrappers>(required_types, excluded_types), ...);
+    return resolve(std::type_identity<Query<Wrappers...>>{}, state);
+}
 
-    for (const auto &archetype : archetypes) {
-        if (archetype.table.entities.empty()) {
-            continue;
-        }
+template<typename... Wrappers>
+r::ecs::Resolver::Q<Wrappers...> r::ecs::Resolver::resolve(std::type_identity<r::ecs::Query<Wrappers...>>, QueryState &state)
+{
+    if (state.archetype_generation != _scene->get_archetype_generation()) {
+        _update_query_state<Wrappers...>(state);
+    }
 
-        bool match = true;
+    std::vector<typename Q<Wrappers...>::Chunk> chunks;
+    const auto &archetypes = _scene->get_archetypes();
 
-        for (const auto &req_type : required_types) {
-            if (!archetype.has_component(req_type)) {
-                match = false;
-                break;
-            }
-        }
-        if (!match)
-            continue;
-
-        for (const auto &excl_type : excluded_types) {
-            if (archetype.has_component(excl_type)) {
-                match = false;
-                break;
-            }
-        }
-        if (!match)
-            continue;
+    chunks.reserve(state.matched_archetypes.size());
+    for (const usize archetype_idx : state.matched_archetypes) {
+        const Archetype &archetype = archetypes[archetype_idx];
 
-        result_entities.insert(result_entities.end(), archetype.table.entities.begin(), archetype.table.entities.end());
+        if (!archetype.table.entities.empty()) {
+            chunks.push_back(Q<Wrappers...>::make_chunk(archetype));
+        }
     }
 
-    return Q<Wrappers...>(_scene, std::move(result_entities));
+    return Q<Wrappers...>(_scene, std::move(chunks), _last_run, _this_run);
 }
 
 template<typename T>
@@ -102,13 +165,34 @@ T r::ecs::Resolver::resolve(std::type_identity<T>)
  * private
  */
 template<typename W>
-void r::ecs::Resolver::_collect_component_types(std::vector<std::type_index> &required, std::vector<std::type_index> &excluded)
+void r::ecs::Resolver::_collect_component_mask(ComponentMask &required, ComponentMask &excluded)
 {
-    if constexpr (is_mut<W>::value || is_ref<W>::value || is_with<W>::value) {
+    if constexpr (is_sparse_wrapper_v<W>) {
+        /* sparse set components are not part of archetypes, the query matches them row by row */
+    } else if constexpr (is_mut<W>::value || is_ref<W>::value || is_with<W>::value || is_added<W>::value || is_changed<W>::value) {
         using Comp = typename component_of<W>::type;
-        required.push_back(typeid(Comp));
+        required.set(component_id<Comp>());
     } else if constexpr (is_without<W>::value) {
         using Comp = typename component_of<W>::type;
-        excluded.push_back(typeid(Comp));
+        excluded.set(component_id<Comp>());
+    }
+}
+
+template<typename... Wrappers>
+void r::ecs::Resolver::_update_query_state(QueryState &state)
+{
+    const auto &archetypes = _scene->get_archetypes();
+
+    ComponentMask required;
+    ComponentMask excluded;
+    (this->_collect_component_mask<Wrappers>(required, excluded), ...);
+
+    for (usize i = static_cast<usize>(state.archetype_generation); i < archetypes.size(); ++i) {
+        const ComponentMask &mask = archetypes[i].mask;
+
+        if ((mask & required) == required && (mask & excluded).none()) {
+            state.matched_archetypes.push_back(i);
+        }
     }
+    state.archetype_generation = _scene->get_archetype_generation();
 }
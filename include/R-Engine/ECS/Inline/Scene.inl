@@ -1,40 +1,84 @@
 #pragma once
 
 #include "R-Engine/ECS/Scene.hpp"
+#include <R-Engine/Core/Error.hpp>
 #include <algorithm>
 #include <memory>
+#include <utility>
 
 template<typename T>
 void r::ecs::Scene::add_component(Entity e, T comp)
 {
-    auto loc_it = _entity_locations.find(e);
-    if (loc_it == _entity_locations.end())
+    if constexpr (std::is_same_v<T, Parent>) {
+        if (comp.entity == NULL_ENTITY) {
+            _unparent(e);
+        } else {
+            add_child(comp.entity, e);
+        }
+    } else if constexpr (std::is_same_v<T, Children>) {
+        _set_children(e, std::move(comp.entities));
+    } else {
+        _insert_component(e, std::move(comp));
+    }
+}
+
+template<typename T>
+void r::ecs::Scene::remove_component(Entity e)
+{
+    if constexpr (std::is_same_v<T, Parent>) {
+        _unparent(e);
+    } else if constexpr (std::is_same_v<T, Children>) {
+        _clear_children(e);
+    } else {
+        _erase_component<T>(e);
+    }
+}
+
+template<typename T>
+void r::ecs::Scene::_insert_component(Entity e, T comp)
+{
+    EntityLocation *loc_ptr = _find_location(e);
+    if (!loc_ptr)
+        return;
+
+    const ComponentId comp_id = component_id<T>();
+
+    if constexpr (is_sparse_component_v<T>) {
+        SparseSet &set = _sparse_set_of<T>();
+        const u32 slot = set.dense_index(e);
+
+        if (slot == INVALID_INDEX) {
+            set.insert(e, &comp, get_change_tick());
+        } else {
+            *static_cast<T *>(set.column().get_ptr(slot)) = std::move(comp);
+            set.column().changed_ticks()[slot] = get_change_tick();
+        }
         return;
+    }
 
-    auto &loc = loc_it->second;
+    auto &loc = *loc_ptr;
     const usize old_archetype_idx = loc.archetype_index;
-    const std::type_index comp_type = typeid(T);
 
     /** If the component already exists, just update it. */
-    if (_archetypes[old_archetype_idx].has_component(comp_type)) {
-        Archetype &arch = _archetypes[old_archetype_idx];
-        *static_cast<T *>(arch.table.columns[arch.component_map.at(comp_type)]->get_ptr(loc.table_row)) = std::move(comp);
+    if (_archetypes[old_archetype_idx].has_component(comp_id)) {
+        Column &column = _archetypes[old_archetype_idx].table.columns[_archetypes[old_archetype_idx].column_index(comp_id)];
+        *static_cast<T *>(column.get_ptr(loc.table_row)) = std::move(comp);
+        column.changed_ticks()[loc.table_row] = get_change_tick();
         return;
     }
 
     /** --- Find or Create Destination Archetype (this may reallocate _archetypes) --- */
-    usize new_archetype_idx;
-    auto edge_it = _archetypes[old_archetype_idx].add_edge.find(comp_type);
+    usize new_archetype_idx = Archetype::get_edge(_archetypes[old_archetype_idx].add_edge, comp_id);
 
-    if (edge_it != _archetypes[old_archetype_idx].add_edge.end()) {
-        new_archetype_idx = edge_it->second;
-    } else {
-        auto new_types = _archetypes[old_archetype_idx].component_types;
-        new_types.push_back(comp_type);
-        std::sort(new_types.begin(), new_types.end());
-        new_archetype_idx = _find_or_create_archetype(new_types);
-        _archetypes[old_archetype_idx].add_edge[comp_type] = new_archetype_idx;
-        _archetypes[new_archetype_idx].remove_edge[comp_type] = old_archetype_idx;
+    if (new_archetype_idx == INVALID_INDEX) {
+        std::vector<const ComponentInfo *> new_infos;
+        for (const auto &column : _archetypes[old_archetype_idx].table.columns) {
+            new_infos.push_back(column.info());
+        }
+        new_infos.push_back(&component_info<T>());
+        new_archetype_idx = _find_or_create_archetype(std::move(new_infos));
+        Archetype::set_edge(_archetypes[old_archetype_idx].add_edge, comp_id, new_archetype_idx);
+        Archetype::set_edge(_archetypes[new_archetype_idx].remove_edge, comp_id, old_archetype_idx);
     }
 
     /** --- Move entity and common components to the new archetype --- */
@@ -42,39 +86,50 @@ void r::ecs::Scene::add_component(Entity e, T comp)
 
     /** --- Add the new component to the new location --- */
     Archetype &new_archetype = _archetypes[new_archetype_idx];
-    const usize new_comp_col_idx = new_archetype.component_map.at(comp_type);
-    if (!new_archetype.table.columns[new_comp_col_idx]) {
-        new_archetype.table.columns[new_comp_col_idx] = std::make_unique<Column<T>>();
-    }
-    new_archetype.table.columns[new_comp_col_idx]->push_back(std::move(comp));
+    new_archetype.table.columns[new_archetype.column_index(comp_id)].push_move(&comp, get_change_tick());
 }
 
 template<typename T>
-void r::ecs::Scene::remove_component(Entity e)
+void r::ecs::Scene::_erase_component(Entity e)
 {
-    auto loc_it = _entity_locations.find(e);
-    if (loc_it == _entity_locations.end())
+    EntityLocation *loc_ptr = _find_location(e);
+    if (!loc_ptr)
         return;
 
-    auto &loc = loc_it->second;
+    const ComponentId comp_id = component_id<T>();
+
+    if constexpr (is_sparse_component_v<T>) {
+        SparseSet *set = comp_id < _sparse_sets.size() ? _sparse_sets[comp_id].get() : nullptr;
+
+        if (set && set->remove(e) && _tracked_removals.test(comp_id)) {
+            _removed_logs[comp_id].pending.push_back(e);
+        }
+        return;
+    }
+
+    auto &loc = *loc_ptr;
     const usize old_archetype_idx = loc.archetype_index;
-    const std::type_index comp_type = typeid(T);
 
-    if (!_archetypes[old_archetype_idx].has_component(comp_type))
+    if (!_archetypes[old_archetype_idx].has_component(comp_id))
         return;
 
     /** --- Find or Create Destination Archetype (this may reallocate _archetypes) --- */
-    usize new_archetype_idx;
-    auto edge_it = _archetypes[old_archetype_idx].remove_edge.find(comp_type);
+    usize new_archetype_idx = Archetype::get_edge(_archetypes[old_archetype_idx].remove_edge, comp_id);
 
-    if (edge_it != _archetypes[old_archetype_idx].remove_edge.end()) {
-        new_archetype_idx = edge_it->second;
-    } else {
-        auto new_types = _archetypes[old_archetype_idx].component_types;
-        new_types.erase(std::remove(new_types.begin(), new_types.end(), comp_type), new_types.end());
-        new_archetype_idx = _find_or_create_archetype(new_types);
-        _archetypes[old_archetype_idx].remove_edge[comp_type] = new_archetype_idx;
-        _archetypes[new_archetype_idx].add_edge[comp_type] = old_archetype_idx;
+    if (new_archetype_idx == INVALID_INDEX) {
+        std::vector<const ComponentInfo *> new_infos;
+        for (const auto &column : _archetypes[old_archetype_idx].table.columns) {
+            if (column.info()->id != comp_id) {
+                new_infos.push_back(column.info());
+            }
+        }
+        new_archetype_idx = _find_or_create_archetype(std::move(new_infos));
+        Archetype::set_edge(_archetypes[old_archetype_idx].remove_edge, comp_id, new_archetype_idx);
+        Archetype::set_edge(_archetypes[new_archetype_idx].add_edge, comp_id, old_archetype_idx);
+    }
+
+    if (_tracked_removals.test(comp_id)) {
+        _removed_logs[comp_id].pending.push_back(e);
     }
 
     /** --- Move entity and common components to the new archetype --- */
@@ -90,17 +145,21 @@ T *r::ecs::Scene::get_component_ptr(Entity e)
         return nullptr;
     }
 
-    const Archetype &archetype = _archetypes[loc->archetype_index];
-    const std::type_index comp_type = typeid(T);
+    if constexpr (is_sparse_component_v<T>) {
+        const SparseSet *set = get_sparse_set(component_id<T>());
+        const u32 slot = set ? set->dense_index(e) : INVALID_INDEX;
 
-    const auto comp_it = archetype.component_map.find(comp_type);
+        return slot != INVALID_INDEX ? static_cast<T *>(set->column().get_ptr(slot)) : nullptr;
+    }
+
+    const Archetype &archetype = _archetypes[loc->archetype_index];
+    const u32 col_idx = archetype.column_index(component_id<T>());
 
-    if (comp_it == archetype.component_map.end()) {
+    if (col_idx == INVALID_INDEX) {
         return nullptr;
     }
 
-    const usize col_idx = comp_it->second;
-    return static_cast<T *>(archetype.table.columns[col_idx]->get_ptr(loc->table_row));
+    return static_cast<T *>(archetype.table.columns[col_idx].get_ptr(loc->table_row));
 }
 
 template<typename T>
@@ -112,35 +171,248 @@ bool r::ecs::Scene::has_component(Entity e) const
         return false;
     }
 
+    if constexpr (is_sparse_component_v<T>) {
+        const SparseSet *set = get_sparse_set(component_id<T>());
+        return set && set->contains(e);
+    }
+
     const Archetype &archetype = _archetypes[loc->archetype_index];
-    return archetype.has_component(typeid(T));
+    return archetype.has_component(component_id<T>());
+}
+
+template<typename... Components>
+r::ecs::Entity r::ecs::Scene::spawn(Components... components)
+{
+    static_assert(((bundle_count_v<Components, Components...> == 1) && ...), "r::ecs::Scene::spawn: duplicate component type in bundle");
+
+    const Entity e = _allocate_entity();
+
+    _place_bundle(e, components...);
+    return e;
+}
+
+template<typename... Components>
+void r::ecs::Scene::spawn_reserved(Entity e, Components... components)
+{
+    static_assert(((bundle_count_v<Components, Components...> == 1) && ...),
+        "r::ecs::Scene::spawn_reserved: duplicate component type in bundle");
+
+    _claim_reserved(e);
+    _place_bundle(e, components...);
+}
+
+template<typename... Components>
+std::vector<r::ecs::Entity> r::ecs::Scene::spawn_batch(std::vector<std::tuple<Components...>> bundles)
+{
+    static_assert(((bundle_count_v<Components, Components...> == 1) && ...), "r::ecs::Scene::spawn_batch: duplicate component type in bundle");
+
+    std::vector<Entity> entities;
+    entities.reserve(bundles.size());
+    for (usize i = 0; i < bundles.size(); ++i) {
+        entities.push_back(reserve_entity());
+    }
+    flush_reserved_entities();
+    _place_batch(entities, bundles);
+    return entities;
+}
+
+template<typename... Components>
+void r::ecs::Scene::spawn_batch_reserved(const std::vector<Entity> &entities, std::vector<std::tuple<Components...>> bundles)
+{
+    static_assert(((bundle_count_v<Components, Components...> == 1) && ...),
+        "r::ecs::Scene::spawn_batch_reserved: duplicate component type in bundle");
+
+    if (entities.size() != bundles.size()) {
+        throw exception::Error("r::ecs::Scene::spawn_batch_reserved", "got ", entities.size(), " entities for ", bundles.size(), " bundles");
+    }
+    for (const Entity e : entities) {
+        _claim_reserved(e);
+    }
+    _place_batch(entities, bundles);
+}
+
+template<typename... Components>
+void r::ecs::Scene::_place_bundle(Entity e, Components &...components)
+{
+    const usize archetype_idx = _find_or_create_bundle_archetype<Components...>();
+    [[maybe_unused]] const u32 tick = get_change_tick();
+    Archetype &archetype = _archetypes[archetype_idx];
+
+    _entity_locations[entity_index(e)] = {archetype_idx, archetype.table.add_entity(e)};
+    (
+        [&] {
+            if constexpr (is_sparse_component_v<Components>) {
+                _sparse_set_of<Components>().insert(e, &components, tick);
+            } else {
+                archetype.table.columns[archetype.column_index(component_id<Components>())].push_move(&components, tick);
+            }
+        }(),
+        ...);
+    _link_placed<Components...>(e);
+}
+
+template<typename... Components>
+void r::ecs::Scene::_place_batch(const std::vector<Entity> &entities, std::vector<std::tuple<Components...>> &bundles)
+{
+    if (bundles.empty()) {
+        return;
+    }
+
+    const usize archetype_idx = _find_or_create_bundle_archetype<Components...>();
+    Archetype &archetype = _archetypes[archetype_idx];
+    Table &table = archetype.table;
+    const u32 tick = get_change_tick();
+
+    if (table.entities.size() + entities.size() > table.entities.capacity()) {
+        table.entities.reserve((std::max)(table.entities.size() + entities.size(), table.entities.capacity() * 2));
+    }
+    for (const Entity e : entities) {
+        _entity_locations[entity_index(e)] = {archetype_idx, table.add_entity(e)};
+    }
+
+    /** Append one whole column at a time */
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (
+            [&] {
+                if constexpr (is_sparse_component_v<Components>) {
+                    SparseSet &set = _sparse_set_of<Components>();
+
+                    for (usize i = 0; i < bundles.size(); ++i) {
+                        set.insert(entities[i], &std::get<I>(bundles[i]), tick);
+                    }
+                } else {
+                    Column &column = table.columns[archetype.column_index(component_id<Components>())];
+
+                    column.reserve(column.size() + bundles.size());
+                    for (auto &bundle : bundles) {
+                        column.push_move(&std::get<I>(bundle), tick);
+                    }
+                }
+            }(),
+            ...);
+    }(std::index_sequence_for<Components...>{});
+    for (const Entity e : entities) {
+        _link_placed<Components...>(e);
+    }
+}
+
+template<typename... Components>
+void r::ecs::Scene::_link_placed(Entity e)
+{
+    /* spawned Parent and Children components go through the hierarchy index like add_component */
+    if constexpr ((std::is_same_v<Components, Children> || ...)) {
+        _link_spawned_children(e);
+    }
+    if constexpr ((std::is_same_v<Components, Parent> || ...)) {
+        _link_spawned_parent(e);
+    }
+}
+
+template<typename... Components>
+usize r::ecs::Scene::_find_or_create_bundle_archetype()
+{
+    ComponentMask mask;
+    ((is_sparse_component_v<Components> ? void() : void(mask.set(component_id<Components>()))), ...);
+
+    const auto it = _archetype_map.find(mask);
+    if (it != _archetype_map.end()) {
+        return it->second;
+    }
+
+    std::vector<const ComponentInfo *> infos;
+    ((is_sparse_component_v<Components> ? void() : infos.push_back(&component_info<Components>())), ...);
+    return _find_or_create_archetype(std::move(infos));
 }
 
 template<typename T>
-void r::ecs::Scene::insert_resource(T &&r) noexcept
+r::ecs::SparseSet &r::ecs::Scene::_sparse_set_of()
 {
-    using DecayedT = std::decay_t<T>;
-    _resources.insert_or_assign(std::type_index(typeid(DecayedT)), std::make_shared<DecayedT>(std::forward<T>(r)));
+    const ComponentId id = component_id<T>();
+
+    if (id >= _sparse_sets.size()) {
+        _sparse_sets.resize(id + 1);
+    }
+    if (!_sparse_sets[id]) {
+        _sparse_sets[id] = std::make_unique<SparseSet>(&component_info<T>());
+    }
+    return *_sparse_sets[id];
 }
 
 template<typename T>
-void r::ecs::Scene::remove_resource() noexcept
+void r::ecs::Scene::track_removed_components()
 {
-    _resources.erase(std::type_index(typeid(T)));
+    const ComponentId id = component_id<T>();
+
+    if (id >= _removed_logs.size()) {
+        _removed_logs.resize(id + 1);
+    }
+    _tracked_removals.set(id);
 }
 
 template<typename T>
-T *r::ecs::Scene::get_resource_ptr() noexcept
+const std::vector<r::ecs::Entity> &r::ecs::Scene::get_removed_components() const noexcept
 {
-    const auto it = _resources.find(std::type_index(typeid(T)));
+    static const std::vector<Entity> empty;
+    const ComponentId id = component_id<T>();
 
-    if (it == _resources.end()) {
-        return nullptr;
+    return _tracked_removals.test(id) ? _removed_logs[id].readable : empty;
+}
+
+template<typename... Filters>
+void r::ecs::Scene::despawn_all()
+{
+    EntityFilter filter;
+
+    (
+        [&filter] {
+            using Filter = despawn_filter<Filters>;
+            using Comp = typename Filter::type;
+
+            if constexpr (is_sparse_component_v<Comp>) {
+                (Filter::excluded ? filter.sparse_excluded : filter.sparse_required).set(component_id<Comp>());
+            } else {
+                (Filter::excluded ? filter.excluded : filter.required).set(component_id<Comp>());
+            }
+        }(),
+        ...);
+    _despawn_matching(filter);
+}
+
+template<typename T>
+r::ecs::ResourceId r::ecs::resource_id()
+{
+    static const ResourceId id = register_resource_id(typeid(T));
+    return id;
+}
+
+template<typename T>
+void r::ecs::Scene::insert_resource(T &&r) noexcept
+{
+    using DecayedT = std::decay_t<T>;
+    const ResourceId id = resource_id<DecayedT>();
+
+    while (_resources.size() <= id) {
+        _resources.emplace_back(nullptr, [](void *) noexcept {});
     }
+    _resources[id] = ResourceBox(new DecayedT(std::forward<T>(r)), [](void *ptr) noexcept { delete static_cast<DecayedT *>(ptr); });
+    ++_resource_generation;
+}
+
+template<typename T>
+void r::ecs::Scene::remove_resource() noexcept
+{
+    const ResourceId id = resource_id<T>();
 
-    if (auto *ptr_to_shared_ptr = std::any_cast<std::shared_ptr<T>>(&it->second)) {
-        return ptr_to_shared_ptr->get();
+    if (id < _resources.size()) {
+        _resources[id].reset();
+        ++_resource_generation;
     }
+}
+
+template<typename T>
+T *r::ecs::Scene::get_resource_ptr() noexcept
+{
+    const ResourceId id = resource_id<T>();
 
-    return nullptr;
+    return id < _resources.size() ? static_cast<T *>(_resources[id].get()) : nullptr;
 }
@@ -2,40 +2,35 @@
 
 #include "R-Engine/ECS/Storage.hpp"
 
+#include <new>
+#include <type_traits>
+#include <utility>
+
 /**
  * Storage Template Implementations
  */
 
 template<typename T>
-void r::ecs::Column<T>::push_back(std::any component)
-{
-    data.push_back(std::any_cast<T>(std::move(component)));
-}
-
-template<typename T>
-void r::ecs::Column<T>::remove_swap_back(usize index)
-{
-    if (index < data.size() - 1) {
-        std::swap(data[index], data.back());
-    }
-    data.pop_back();
-}
-
-template<typename T>
-void *r::ecs::Column<T>::get_ptr(usize index)
+r::ecs::ComponentId r::ecs::component_id()
 {
-    return &data[index];
+    static const ComponentId id = register_component_id(typeid(T));
+    return id;
 }
 
 template<typename T>
-void r::ecs::Column<T>::move_to(usize index, IColumn &dest)
+const r::ecs::ComponentInfo &r::ecs::component_info()
 {
-    auto &dest_col = static_cast<Column<T> &>(dest);
-    dest_col.data.push_back(std::move(data[index]));
-}
+    static_assert(std::is_move_constructible_v<T>, "r::ecs components must be move constructible");
 
-template<typename T>
-std::shared_ptr<r::ecs::IColumn> r::ecs::Column<T>::clone_empty() const
-{
-    return std::make_shared<Column<T>>();
+    static const ComponentInfo info{
+        typeid(T),
+        component_id<T>(),
+        sizeof(T),
+        alignof(T),
+        [](void *dst, void *src) { ::new (dst) T(std::move(*static_cast<T *>(src))); },
+        [](void *ptr) { static_cast<T *>(ptr)->~T(); },
+        std::is_trivially_copyable_v<T>,
+        component_storage<T>::value,
+    };
+    return info;
 }
@@ -39,12 +39,50 @@ struct system_param_access<T, std::enable_if_t<is_resmut<T>::value>> {
         }
 };
 
+/**
+ * @brief EventWriter<T> and EventReader<T> both count as shared access to Events<T>
+ * @info sending is thread safe and never touches the readable events, so writers and readers may share a stage,
+ * only Events<T>::update (through ResMut<Events<T>>) needs exclusive access
+ */
+template<typename T>
+struct system_param_access<T, std::enable_if_t<is_event_writer<T>::value || is_event_reader<T>::value>> {
+        static void get(sys::Access R_UNUSED &comp_access, sys::Access &res_access)
+        {
+            (void) comp_access;
+            res_access.reads.insert(typeid(Events<typename T::EventType>));
+        }
+};
+
+/**
+ * @brief Hierarchy is a shared read of the HierarchyIndex, the index only changes when commands are applied
+ */
+template<>
+struct system_param_access<Hierarchy> {
+        static void get(sys::Access R_UNUSED &comp_access, sys::Access &res_access)
+        {
+            (void) comp_access;
+            res_access.reads.insert(typeid(HierarchyIndex));
+        }
+};
+
+/**
+ * @brief Scene & gives the system the whole world, it is exclusive: the scheduler orders it against every other system
+ */
+template<>
+struct system_param_access<Scene> {
+        static void get(sys::Access R_UNUSED &comp_access, sys::Access &res_access)
+        {
+            (void) comp_access;
+            res_access.writes.insert(typeid(Scene));
+        }
+};
+
 template<typename W>
 void get_query_wrapper_access(sys::Access &comp_access)
 {
     if constexpr (is_mut<W>::value) {
         comp_access.writes.insert(typeid(typename component_of<W>::type));
-    } else if constexpr (is_ref<W>::value || is_optional<W>::value) {
+    } else if constexpr (is_ref<W>::value || is_optional<W>::value || is_added<W>::value || is_changed<W>::value) {
         comp_access.reads.insert(typeid(typename component_of<W>::type));
     }
 }
@@ -57,6 +95,33 @@ struct system_param_access<Query<T...>> {
             (get_query_wrapper_access<T>(comp_access), ...);
         }
 };
+
+/**
+ * @brief one-time scene setup required by a system parameter.
+ */
+template<typename T>
+void init_system_param(Scene &scene)
+{
+    if constexpr (is_removed_components<T>::value) {
+        scene.track_removed_components<typename T::ComponentType>();
+    } else {
+        (void) scene;
+    }
+}
+
+/**
+ * @brief resolves a system parameter, handing it its persistent state when it has one.
+ */
+template<typename T, typename State>
+decltype(auto) resolve_param(Resolver &resolver, State &state)
+{
+    if constexpr (std::is_same_v<State, std::monostate>) {
+        return resolver.resolve(std::type_identity<T>{});
+    } else {
+        return resolver.resolve(std::type_identity<T>{}, state);
+    }
+}
+
 }// namespace detail
 
 /**
@@ -68,23 +133,52 @@ void get_system_access(sys::Access &comp_access, sys::Access &res_access)
 {
     using traits = function_traits<std::remove_cvref_t<decltype(Func)>>;
     using args_tuple = typename traits::args;
-    std::apply([&](auto... args) { (detail::system_param_access<decltype(args)>::get(comp_access, res_access), ...); }, args_tuple{});
+    [&]<typename... Args>(std::type_identity<std::tuple<Args...>>) {
+        (detail::system_param_access<Args>::get(comp_access, res_access), ...);
+    }(std::type_identity<args_tuple>{});
+}
+
+template<typename Func>
+void init_system_params(Scene &scene)
+{
+    using args_tuple = typename function_traits<std::remove_cvref_t<Func>>::args;
+    [&]<typename... Args>(std::type_identity<std::tuple<Args...>>) {
+        (detail::init_system_param<Args>(scene), ...);
+    }(std::type_identity<args_tuple>{});
 }
 
 template<typename Func, typename... Args, size_t... I>
-static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd, std::tuple<Args...>, std::index_sequence<I...>)
+static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd, std::type_identity<std::tuple<Args...>>,
+    std::index_sequence<I...>)
 {
     Resolver resolver(&scene, &cmd);
-    auto resolved_args = std::make_tuple(resolver.resolve(std::type_identity<Args>{})...);
+    std::tuple<decltype(resolver.resolve(std::type_identity<Args>{}))...> resolved_args{resolver.resolve(std::type_identity<Args>{})...};
+
+    return std::apply(std::forward<Func>(f), resolved_args);
+}
+
+template<typename Func, typename State, typename... Args, size_t... I>
+static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd, State &state,
+    std::type_identity<std::tuple<Args...>>, std::index_sequence<I...>)
+{
+    const u32 this_run = scene.increment_change_tick();
+    Resolver resolver(&scene, &cmd, state.last_run, this_run);
+
+    /* a tuple of the exact resolved types, so Scene & stays a reference */
+    std::tuple<decltype(detail::resolve_param<Args>(resolver, std::get<I>(state.params)))...> resolved_args{
+        detail::resolve_param<Args>(resolver, std::get<I>(state.params))...};
+
+    state.last_run = this_run;
     return std::apply(std::forward<Func>(f), resolved_args);
 }
 
 template<typename Predicate, typename... Args, size_t... I>
-static inline bool call_predicate_with_resolved(Predicate &&p, Scene &scene, CommandBuffer &cmd, std::tuple<Args...>,
-    std::index_sequence<I...>)
+static inline bool call_predicate_with_resolved(Predicate &&p, Scene &scene, CommandBuffer &cmd,
+    std::type_identity<std::tuple<Args...>>, std::index_sequence<I...>)
 {
     Resolver resolver(&scene, &cmd);
-    auto resolved_args = std::make_tuple(resolver.resolve(std::type_identity<Args>{})...);
+    std::tuple<decltype(resolver.resolve(std::type_identity<Args>{}))...> resolved_args{resolver.resolve(std::type_identity<Args>{})...};
+
     return static_cast<bool>(std::apply(std::forward<Predicate>(p), resolved_args));
 }
 
@@ -94,7 +188,16 @@ static inline void run_system(Func &&f, Scene &scene, CommandBuffer &cmd)
     using traits = function_traits<std::remove_cvref_t<Func>>;
     using args = typename traits::args;
 
-    call_with_resolved(std::forward<Func>(f), scene, cmd, args{}, std::make_index_sequence<std::tuple_size_v<args>>{});
+    call_with_resolved(std::forward<Func>(f), scene, cmd, std::type_identity<args>{}, std::make_index_sequence<std::tuple_size_v<args>>{});
+}
+
+template<typename Func>
+static inline void run_system(Func &&f, Scene &scene, CommandBuffer &cmd, system_state_t<Func> &state)
+{
+    using traits = function_traits<std::remove_cvref_t<Func>>;
+    using args = typename traits::args;
+
+    call_with_resolved(std::forward<Func>(f), scene, cmd, state, std::type_identity<args>{}, std::make_index_sequence<std::tuple_size_v<args>>{});
 }
 
 }// namespace ecs
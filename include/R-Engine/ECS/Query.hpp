@@ -1,7 +1,14 @@
 #pragma once
 
+#include <R-Engine/Core/ThreadPool.hpp>
+#include <R-Engine/ECS/Event.hpp>
 #include <R-Engine/ECS/Scene.hpp>
 
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
 namespace r {
 
 namespace ecs {
@@ -32,6 +39,35 @@ struct ResMut {
         T *ptr = nullptr;
 };
 
+/**
+ * @brief RemovedComponents
+ * @info read-only list of the entities that lost component <T> during the previous frame,
+ * either because it was removed or because the entity was despawned.
+ * example: evicting cached GPU handles of despawned entities without scanning the world
+ */
+template<typename T>
+struct RemovedComponents {
+        using ComponentType = T;
+        const std::vector<Entity> *entities = nullptr;
+
+        auto begin() const
+        {
+            return entities->begin();
+        }
+        auto end() const
+        {
+            return entities->end();
+        }
+        usize size() const
+        {
+            return entities->size();
+        }
+        bool empty() const
+        {
+            return entities->empty();
+        }
+};
+
 /**
  * @brief Mut
  * @info mutable access to component <T>
@@ -68,6 +104,23 @@ template<typename T>
 struct Without {
 };
 
+/**
+ * @brief Added (Filter)
+ * @info requires component <T> and keeps only the entities it was added to since the last run of the system.
+ */
+template<typename T>
+struct Added {
+};
+
+/**
+ * @brief Changed (Filter)
+ * @info requires component <T> and keeps only the entities it was added to or mutably accessed on
+ * since the last run of the system. a Mut<T> marks a row as changed when the query hands it out.
+ */
+template<typename T>
+struct Changed {
+};
+
 /**
  * @brief Optional
  * @info provides conditional read-only access to component <T>.
@@ -90,6 +143,10 @@ template<typename>
 struct is_resmut : std::false_type {
 };
 
+template<typename>
+struct is_removed_components : std::false_type {
+};
+
 template<typename>
 struct is_mut : std::false_type {
 };
@@ -110,6 +167,14 @@ template<typename>
 struct is_optional : std::false_type {
 };
 
+template<typename>
+struct is_added : std::false_type {
+};
+
+template<typename>
+struct is_changed : std::false_type {
+};
+
 template<typename T>
 struct is_res<Res<T>> : std::true_type {
 };
@@ -118,6 +183,10 @@ template<typename T>
 struct is_resmut<ResMut<T>> : std::true_type {
 };
 
+template<typename T>
+struct is_removed_components<RemovedComponents<T>> : std::true_type {
+};
+
 template<typename T>
 struct is_mut<Mut<T>> : std::true_type {
 };
@@ -138,6 +207,14 @@ template<typename T>
 struct is_optional<Optional<T>> : std::true_type {
 };
 
+template<typename T>
+struct is_added<Added<T>> : std::true_type {
+};
+
+template<typename T>
+struct is_changed<Changed<T>> : std::true_type {
+};
+
 /**
 * helper to extract component type from wrapper
 */
@@ -170,9 +247,46 @@ struct component_of<Optional<T>> {
         using type = T;
 };
 
+template<typename T>
+struct component_of<Added<T>> {
+        using type = T;
+};
+
+template<typename T>
+struct component_of<Changed<T>> {
+        using type = T;
+};
+
+/**
+* @brief true when the component accessed or filtered by wrapper W lives in a sparse set
+* @info such wrappers are matched per row instead of per archetype
+*/
+template<typename W>
+inline constexpr bool is_sparse_wrapper_v = is_sparse_component_v<typename component_of<W>::type>;
+
+/**
+* @brief QueryState
+* @info persistent cache of the archetypes matched by a Query, owned by the system using it.
+* archetypes are append-only, so only those created after archetype_generation need to be tested again.
+*/
+struct QueryState {
+        std::vector<usize> matched_archetypes;
+        u64 archetype_generation = 0;
+};
+
+/**
+* @brief ResourceState
+* @info persistent cache of a resource pointer, owned by the system using it.
+* the pointer is looked up again only when the resource generation of the scene changed.
+*/
+struct ResourceState {
+        void *ptr = nullptr;
+        u64 resource_generation = 0;
+};
+
 /**
 * @brief query
-* @info accepts wrappers Mut<T> / Ref<T> / With<T> / Without<T> / Optional<T>
+* @info accepts wrappers Mut<T> / Ref<T> / With<T> / Without<T> / Optional<T> / Added<T> / Changed<T>
 *
 * void complex_system(Query<Mut<Position>, Without<Velocity>, Optional<Health>> q)
 * {
@@ -188,16 +302,38 @@ struct component_of<Optional<T>> {
 template<typename... Wrappers>
 struct Query {
     public:
+        /**
+        * @brief chunk
+        * @info a contiguous slice of one matched archetype Table.
+        * column base pointers are resolved once per table (one per wrapper, nullptr for filters
+        * and missing Optional<T>), so reaching a row is plain array indexing.
+        * ticks holds the changed ticks of Mut<T> / Changed<T> columns and the added ticks of Added<T> columns.
+        */
+        struct Chunk {
+                const Entity *entities = nullptr;
+                usize count = 0;
+                std::array<void *, sizeof...(Wrappers)> columns{};
+                std::array<u32 *, sizeof...(Wrappers)> ticks{};
+        };
+
+        /**
+        * @brief true when rows have to be tested one by one, against Added<T> / Changed<T>
+        * or against the sparse sets of SparseSet storage components
+        */
+        static constexpr bool has_row_filters = ((is_added<Wrappers>::value || is_changed<Wrappers>::value
+                                                     || (is_sparse_wrapper_v<Wrappers> && !is_optional<Wrappers>::value))
+            || ...);
+
         constexpr Query() = default;
-        explicit Query(Scene *scene, std::vector<Entity> entities);
+        explicit Query(Scene *scene, std::vector<Chunk> chunks, u32 last_run = 0, u32 this_run = 0);
 
         /**
         * @brief iterator
-        * @info iterates over entities, yielding tuples of wrappers
+        * @info iterates over matched tables then over their rows, yielding tuples of wrappers
         */
         struct Iterator {
             public:
-                explicit Iterator(Scene *scene, const std::vector<Entity> *list, u64 i);
+                explicit Iterator(const Query *query, usize chunk, usize row);
 
                 bool operator!=(const Iterator &other) const;
                 bool operator==(const Iterator &other) const;
@@ -207,21 +343,75 @@ struct Query {
                 Entity entity() const;
 
                 template<typename W>
-                static W build_wrapper(Scene *scene, Entity e);
+                static W build_wrapper(void *column, u32 *ticks, usize row, u32 this_run);
 
             private:
-                Scene *_scene = nullptr;
-                const std::vector<Entity> *_list;
-                u64 _idx = 0;
+                const Query *_query = nullptr;
+                usize _chunk = 0;
+                usize _row = 0;
+
+                /**
+                * @brief moves to the first row at or after the current one that exists and passes the row filters
+                * @info chunks of archetypes emptied since the query was built are skipped
+                */
+                void _skip_unmatched();
+
+                template<size_t... I>
+                auto _build_row(std::index_sequence<I...>) const;
         };
 
         Iterator begin() const;
         Iterator end() const;
+
+        /**
+        * @brief number of entities yielded by the query
+        * @info O(1), except with row filters (see has_row_filters) where every matched row is tested
+        */
         u64 size() const;
 
+        /**
+        * @brief calls func(wrappers...) for every matched entity
+        * @info walks each table with a tight row loop, cheaper than the iterator when the entity id is not needed
+        */
+        template<typename Func>
+        void for_each(Func &&func) const;
+
+        /**
+        * @brief calls func(wrappers...) for every matched entity, spread over the scene thread pool
+        * @info tables are cut into batches of batch_size rows, each batch runs on one thread and the call
+        * returns once every batch is done. rows are disjoint, so Mut<T> access stays exclusive per entity,
+        * but func must not touch state shared between rows without synchronisation.
+        * falls back to for_each when the scene has no thread pool or when there is a single batch.
+        */
+        template<typename Func>
+        void par_for_each(usize batch_size, Func &&func) const;
+
+        /**
+        * @brief resolves the column base pointers of an archetype matched by this query
+        * @param archetype an archetype containing every required component of the query
+        */
+        static Chunk make_chunk(const Archetype &archetype);
+
     private:
         Scene *_scene = nullptr;
-        std::vector<Entity> _entities;
+        std::vector<Chunk> _chunks;
+        u64 _size = 0;
+        u32 _last_run = 0;
+        u32 _this_run = 0;
+        std::array<const SparseSet *, sizeof...(Wrappers)> _sparse{};
+
+        template<typename W>
+        static void *_column_of(const Archetype &archetype);
+        template<typename W>
+        static const SparseSet *_sparse_of(const Scene *scene);
+        template<size_t I>
+        auto _wrapper_at(const Chunk &chunk, usize row) const;
+        template<typename W>
+        static u32 *_ticks_of(const Archetype &archetype);
+
+        bool _row_matches(const Chunk &chunk, usize row) const;
+        template<size_t... I>
+        void _run_rows(const Chunk &chunk, usize begin, usize end, auto &func, std::index_sequence<I...>) const;
 };
 
 }// namespace ecs
@@ -6,13 +6,21 @@
 #include <R-Engine/ECS/Query.hpp>
 #include <R-Engine/ECS/Scene.hpp>
 
-#include <typeindex>
 #include <vector>
 
 namespace r {
 
 namespace ecs {
 
+/**
+* @brief EventReaderState
+* @info persistent state of an EventReader<T> system parameter: the cached Events<T> and the position of the reader.
+*/
+struct EventReaderState {
+        ResourceState events;
+        EventCursor cursor;
+};
+
 struct R_ENGINE_API Resolver {
     public:
         template<typename... Wrappers>
@@ -20,22 +28,37 @@ struct R_ENGINE_API Resolver {
 
         /**
          * @brief Construct a new Resolver object
+         * @details Resolves parameters for a one-shot run: the change tick of the scene is advanced and every
+         * component counts as added and changed for Added<T> / Changed<T> filters.
          * @param s A pointer to the scene.
          * @param cmd A pointer to the command buffer.
          */
         explicit Resolver(Scene *s, CommandBuffer *cmd);
 
+        /**
+         * @brief Construct a new Resolver object for a system run
+         * @param s A pointer to the scene.
+         * @param cmd A pointer to the command buffer.
+         * @param last_run The change tick of the previous run of the system, 0 if it never ran.
+         * @param this_run The change tick of the current run of the system.
+         */
+        explicit Resolver(Scene *s, CommandBuffer *cmd, u32 last_run, u32 this_run);
+
         /**
          * @brief Res<T>
          */
         template<typename T>
         Res<T> resolve(std::type_identity<Res<T>>);
+        template<typename T>
+        Res<T> resolve(std::type_identity<Res<T>>, ResourceState &state);
 
         /**
         * @brief EventWriter<T>
         */
         template<typename T>
         EventWriter<T> resolve(std::type_identity<EventWriter<T>>);
+        template<typename T>
+        EventWriter<T> resolve(std::type_identity<EventWriter<T>>, ResourceState &state);
 
         /**
         * @brief EventReader<T>
@@ -43,11 +66,27 @@ struct R_ENGINE_API Resolver {
         template<typename T>
         EventReader<T> resolve(std::type_identity<EventReader<T>>);
 
+        /**
+        * @brief EventReader<T> of a system, reads what was published since its previous run and moves its cursor
+        */
+        template<typename T>
+        EventReader<T> resolve(std::type_identity<EventReader<T>>, EventCursor &cursor);
+        template<typename T>
+        EventReader<T> resolve(std::type_identity<EventReader<T>>, EventReaderState &state);
+
         /**
          * @brief ResMut<T>
          */
         template<typename T>
         ResMut<T> resolve(std::type_identity<ResMut<T>>);
+        template<typename T>
+        ResMut<T> resolve(std::type_identity<ResMut<T>>, ResourceState &state);
+
+        /**
+        * @brief RemovedComponents<T>
+        */
+        template<typename T>
+        RemovedComponents<T> resolve(std::type_identity<RemovedComponents<T>>);
 
         /**
         * @brief Commands
@@ -55,16 +94,31 @@ struct R_ENGINE_API Resolver {
         Commands resolve(std::type_identity<Commands>);
 
         /**
-         * @brief Scene
+        * @brief Hierarchy
+        */
+        Hierarchy resolve(std::type_identity<Hierarchy>);
+
+        /**
+         * @brief Scene &
+         * @info the whole world, a system taking it never runs next to another one
          */
-        Scene &resolve(std::type_identity<Scene &>);
+        Scene &resolve(std::type_identity<Scene>);
 
         /**
         * @brief Query<Wrappers...>
+        * @details one-shot resolution, every archetype of the scene is tested.
         */
         template<typename... Wrappers>
         Q<Wrappers...> resolve(std::type_identity<Query<Wrappers...>>);
 
+        /**
+        * @brief Query<Wrappers...>
+        * @details cached resolution, only archetypes created since the last use of the state are tested.
+        * @param state The persistent QueryState of the system owning the query.
+        */
+        template<typename... Wrappers>
+        Q<Wrappers...> resolve(std::type_identity<Query<Wrappers...>>, QueryState &state);
+
         /**
          * @brief fallback for unsupported types
          */
@@ -74,15 +128,39 @@ struct R_ENGINE_API Resolver {
     private:
         Scene *_scene;
         CommandBuffer *_cmd_buffer;
+        u32 _last_run = 0;
+        u32 _this_run = 0;
 
         /**
-         * @brief Helper to collect required and excluded component types from a query wrapper.
+         * @brief Gets a resource through the cached pointer of a system parameter, refreshing it if resources changed.
+         * @tparam T The resource type.
+         * @param state The persistent ResourceState of the parameter.
+         */
+        template<typename T>
+        T *_cached_resource(ResourceState &state);
+
+        /**
+         * @brief Reads the events published since the last read of a cursor, registering the cursor on first use.
+         */
+        template<typename T>
+        EventReader<T> _read_events(Events<T> *events, EventCursor &cursor);
+
+        /**
+         * @brief Helper to collect required and excluded component bits from a query wrapper.
          * @tparam W The wrapper type (e.g., Mut<T>, Without<T>).
-         * @param required Vector to store required type indices.
-         * @param excluded Vector to store excluded type indices.
+         * @param required Mask of the components an archetype must have.
+         * @param excluded Mask of the components an archetype must not have.
          */
         template<typename W>
-        void _collect_component_types(std::vector<std::type_index> &required, std::vector<std::type_index> &excluded);
+        void _collect_component_mask(ComponentMask &required, ComponentMask &excluded);
+
+        /**
+         * @brief Tests the archetypes created since the last update of a QueryState and records the matching ones.
+         * @tparam Wrappers The query wrappers.
+         * @param state The QueryState to bring up to date with the scene.
+         */
+        template<typename... Wrappers>
+        void _update_query_state(QueryState &state);
 };
 
 }// namespace ecs
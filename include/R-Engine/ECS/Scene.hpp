@@ -1,29 +1,77 @@
 #pragma once
 
+#include <R-Engine/ECS/Hierarchy.hpp>
 #include <R-Engine/ECS/Storage.hpp>
 #include <R-Engine/Types.hpp>
 
-#include <any>
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
 #include <typeindex>
 #include <unordered_map>
 #include <vector>
 
 namespace r {
 
+namespace core {
+class ThreadPool;
+}
+
 namespace ecs {
 
+struct Children;
+struct Parent;
+
+/**
+ * @brief Number of occurrences of T in a bundle of component types Ts.
+ */
+template<typename T, typename... Ts>
+inline constexpr usize bundle_count_v = (usize{0} + ... + usize{std::is_same_v<T, Ts>});
+
+/**
+ * @brief Dense ID of a resource type, indexes the resource slots of a Scene.
+ */
+using ResourceId = u32;
+
+/**
+ * @brief Registers a resource type and returns its dense ID, the same type always yields the same ID.
+ * @details Like component IDs, the registry lives in the engine library so IDs are shared across shared-library boundaries.
+ * @param type The type_index of the resource.
+ * @return The dense ID of the resource type.
+ */
+R_ENGINE_API ResourceId register_resource_id(const std::type_index &type);
+
 /**
- * @brief Hasher for a vector of type_index, needed for the archetype map.
+ * @brief Gets the dense ID of a resource type T, looked up once then cached.
  */
-struct TypeVecHasher {
-        usize operator()(const std::vector<std::type_index> &vec) const
-        {
-            usize seed = vec.size();
-            for (const auto &i : vec) {
-                seed ^= i.hash_code() + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-            }
-            return seed;
-        }
+template<typename T>
+ResourceId resource_id();
+
+template<typename T>
+struct With;
+
+template<typename T>
+struct Without;
+
+/**
+ * @brief Filter accepted by Scene::despawn_all, With<T> keeps the entities that have T and Without<T> those that do not.
+ */
+template<typename W>
+struct despawn_filter {
+        static_assert(!sizeof(W), "r::ecs::Scene::despawn_all filters must be With<T> or Without<T>");
+};
+
+template<typename T>
+struct despawn_filter<With<T>> {
+        using type = T;
+        static constexpr bool excluded = false;
+};
+
+template<typename T>
+struct despawn_filter<Without<T>> {
+        using type = T;
+        static constexpr bool excluded = true;
 };
 
 /**
@@ -48,12 +96,15 @@ class R_ENGINE_API Scene : public NonCopyable
         Scene();
         ~Scene() = default;
 
-        using ResourceMap = std::unordered_map<std::type_index, std::any>;
+        /** @brief Owning pointer to a resource, the resource never moves while it is in the scene. */
+        using ResourceBox = std::unique_ptr<void, void (*)(void *) noexcept>;
 
         /**
          * @brief Adds a component of type T to an entity.
          * @details If the entity already has this component, it will be updated.
          * This operation may move the entity to a different archetype.
+         * Parent and Children go through the hierarchy index: adding Parent is add_child(), adding Children
+         * replaces the children of the entity, links that would create a cycle are dropped.
          * @tparam T The type of component to add.
          * @param e The entity to modify.
          * @param comp The component data to add.
@@ -64,6 +115,7 @@ class R_ENGINE_API Scene : public NonCopyable
         /**
          * @brief Removes a component of type T from an entity.
          * @details This operation may move the entity to a different archetype.
+         * Removing Parent detaches the entity from its parent, removing Children detaches all its children.
          * @tparam T The type of component to remove.
          * @param e The entity to modify.
          */
@@ -119,10 +171,92 @@ class R_ENGINE_API Scene : public NonCopyable
          */
         Entity create_entity();
         /**
-         * @brief Destroys an entity and all its components.
+         * @brief Creates a new entity directly in the archetype of a bundle of components.
+         * @details Unlike create_entity() followed by add_component() calls, the entity is never moved
+         * between archetypes.
+         * @tparam Components The component types of the bundle, each type must appear only once.
+         * @param components The components of the new entity.
+         * @return The ID of the newly created entity.
+         */
+        template<typename... Components>
+        Entity spawn(Components... components);
+        /**
+         * @brief Creates one entity per bundle, all of them in the archetype of the bundle type.
+         * @details The destination archetype is resolved once and every column is reserved then
+         * appended in a single pass.
+         * @tparam Components The component types of the bundles, each type must appear only once.
+         * @param bundles The components of the new entities.
+         * @return The IDs of the newly created entities, in bundle order.
+         */
+        template<typename... Components>
+        std::vector<Entity> spawn_batch(std::vector<std::tuple<Components...>> bundles);
+        /**
+         * @brief Reserves the ID of an entity that will be spawned later.
+         * @details Thread safe, may be called concurrently from systems while no structural change happens,
+         * this is how command buffers hand out real IDs at record time. A reserved entity is not alive
+         * until it is spawned with spawn_reserved() or spawn_batch_reserved().
+         * @return The ID of the reserved entity.
+         * @throws r::exception::Error if no entity index is left.
+         */
+        Entity reserve_entity();
+        /**
+         * @brief Takes into account the entities reserved since the last flush.
+         * @details Called by every structural change that allocates entities, call it explicitly only
+         * before reading the entity tables directly. Must not run concurrently with reserve_entity().
+         */
+        void flush_reserved_entities();
+        /**
+         * @brief Spawns a bundle of components on an entity returned by reserve_entity().
+         * @see spawn
+         * @throws r::exception::Error if the entity is not reserved or was already spawned.
+         */
+        template<typename... Components>
+        void spawn_reserved(Entity e, Components... components);
+        /**
+         * @brief Spawns one bundle per reserved entity, all of them in the archetype of the bundle type.
+         * @see spawn_batch
+         * @param entities Entities returned by reserve_entity(), one per bundle.
+         * @throws r::exception::Error if an entity is not reserved or was already spawned.
+         */
+        template<typename... Components>
+        void spawn_batch_reserved(const std::vector<Entity> &entities, std::vector<std::tuple<Components...>> bundles);
+        /**
+         * @brief Destroys an entity and all its components, along with all its descendants.
+         * @details The descendants are found through the hierarchy index, the entity is also removed from
+         * the Children component of its parent.
          * @param e The entity to destroy.
          */
         void destroy_entity(Entity e) noexcept;
+        /**
+         * @brief Destroys every entity matching the filters in a single pass over the archetypes.
+         * @details Matching tables are cleared as a whole instead of swap-removing one row at a time.
+         * Entities that are part of a hierarchy go through destroy_entity, so their descendants are
+         * destroyed too. Filters on sparse set components are checked row by row, and the matching
+         * entities are then destroyed one by one.
+         * @tparam Filters With<T> and Without<T> filters, no filter destroys every entity.
+         */
+        template<typename... Filters>
+        void despawn_all();
+        /**
+         * @brief Makes child the last child of parent.
+         * @details Updates the hierarchy index and mirrors the link in the Children component of the parent
+         * and the Parent component of the child. A child that had another parent is moved.
+         * Does nothing if either entity is dead or if the link would create a cycle.
+         * @param parent The new parent.
+         * @param child The entity to attach.
+         */
+        void add_child(Entity parent, Entity child);
+        /**
+         * @brief Gets the hierarchy index of the scene.
+         */
+        const HierarchyIndex &get_hierarchy() const noexcept;
+        /**
+         * @brief Checks if an entity handle refers to a live entity.
+         * @details Handles of destroyed entities are stale, even once their slot has been reused.
+         * @param e The entity to check.
+         * @return True if the entity is alive, false otherwise.
+         */
+        bool is_alive(Entity e) const noexcept;
 
         /** @name Internal methods for Querying and Commands */
         ///@{
@@ -133,46 +267,143 @@ class R_ENGINE_API Scene : public NonCopyable
          */
         const std::vector<Archetype> &get_archetypes() const;
         /**
-         * @brief Gets the storage location of an entity.
-         * @param e The entity to locate.
-         * @return A const pointer to the entity's location, or nullptr if not found.
+         * @brief Gets the archetype generation of the scene.
+         * @details Incremented every time a new archetype is created. Archetypes are never removed,
+         * so archetypes with an index >= a previously observed generation are the ones created since.
+         * @return The number of archetypes created so far.
+         */
+        u64 get_archetype_generation() const noexcept;
+        /**
+         * @brief Gets the resource generation of the scene.
+         * @details Incremented every time a resource is inserted or removed, a resource pointer fetched
+         * under a generation stays valid as long as the generation does not change.
+         * @return The current resource generation, never 0.
          */
-        const EntityLocation *get_entity_location(Entity e) const;
+        u64 get_resource_generation() const noexcept;
+        /**
+         * @brief Starts recording the entities that lose a component of type T.
+         * @details Recording is opt-in per component type so untracked removals cost nothing, it is enabled
+         * when a system taking a RemovedComponents<T> parameter is added.
+         * @tparam T The component type to track.
+         */
+        template<typename T>
+        void track_removed_components();
+        /**
+         * @brief Gets the entities that lost a component of type T, by removal or despawn, during the previous frame.
+         * @tparam T The tracked component type.
+         * @return The removed entities, empty if T is not tracked.
+         */
+        template<typename T>
+        const std::vector<Entity> &get_removed_components() const noexcept;
+        /**
+         * @brief Makes the removals recorded since the last call readable and drops the previous ones.
+         * @details Called once per frame at EVENT_CLEANUP, mirroring Events<T>::update.
+         */
+        void update_removed_components() noexcept;
 
         /**
-         * @brief Clears the placeholder map used by the command buffer.
+         * @brief Advances the change tick of the scene.
+         * @details Called once per system run, the returned tick is stamped on the components the system
+         * accesses mutably and becomes the system's last run tick afterwards.
+         * @return The new change tick.
          */
-        void clear_command_buffer_placeholder_map() noexcept;
+        u32 increment_change_tick() noexcept;
         /**
-         * @brief Maps a temporary placeholder entity ID to its real ID after creation.
-         * @param placeholder The temporary ID used during command buffer recording.
-         * @param real The final ID assigned by the scene.
+         * @brief Gets the current change tick of the scene, stamped on added and replaced components.
          */
-        void map_command_buffer_placeholder(Entity placeholder, Entity real) noexcept;
+        u32 get_change_tick() const noexcept;
         /**
-         * @brief Gets the placeholder-to-real-entity map.
-         * @return A const reference to the map.
+         * @brief Sets the thread pool used for parallel work on the scene, such as Query::par_for_each.
+         * @param pool The thread pool, or nullptr to run everything on the calling thread.
          */
-        const std::unordered_map<Entity, Entity> &get_command_buffer_placeholder_map() const noexcept;
+        void set_thread_pool(core::ThreadPool *pool) noexcept;
+        /**
+         * @brief Gets the thread pool used for parallel work on the scene.
+         * @return A pointer to the thread pool, or nullptr if none was set.
+         */
+        core::ThreadPool *get_thread_pool() const noexcept;
+        /**
+         * @brief Gets the sparse set holding a SparseSet storage component type.
+         * @param id The ID of the component.
+         * @return A pointer to the set, or nullptr if no component of that type was ever added.
+         */
+        const SparseSet *get_sparse_set(ComponentId id) const noexcept;
+        /**
+         * @brief Gets the storage location of an entity.
+         * @param e The entity to locate.
+         * @return A const pointer to the entity's location, or nullptr if the entity is not alive.
+         */
+        const EntityLocation *get_entity_location(Entity e) const noexcept;
 
         ///@}
 
     private:
         std::vector<Archetype> _archetypes;
-        std::unordered_map<std::vector<std::type_index>, usize, TypeVecHasher> _archetype_map;
-        std::unordered_map<Entity, EntityLocation> _entity_locations;
+        std::unordered_map<ComponentMask, usize> _archetype_map;
+        std::vector<EntityLocation> _entity_locations; /**< Indexed by entity index. */
+        std::vector<u32> _entity_generations;          /**< Current generation of each entity index. */
+        std::vector<u32> _free_entities;               /**< Destroyed entity indices from _free_head on, reused oldest first. */
+        usize _free_head = 0;
+        usize _reservable_free = 0;          /**< Free indices reserve_entity() may hand out until the next flush. */
+        std::atomic<i64> _reserve_cursor{0}; /**< Reservable free indices left, negative once new indices are handed out. */
+
+        std::vector<ResourceBox> _resources; /**< Indexed by resource ID, empty slots are absent resources. */
+        u64 _resource_generation = 1;
+
+        HierarchyIndex _hierarchy;
 
-        ResourceMap _resources;
-        std::unordered_map<Entity, Entity> _placeholder_map;
+        u64 _archetype_generation = 0;
+        core::ThreadPool *_thread_pool = nullptr;
 
-        Entity _next_entity = 1;
+        /** @brief Double-buffered removal log of a tracked component type. */
+        struct RemovedLog {
+                std::vector<Entity> readable;
+                std::vector<Entity> pending;
+        };
+        std::vector<RemovedLog> _removed_logs;               /**< Indexed by component ID. */
+        std::vector<std::unique_ptr<SparseSet>> _sparse_sets; /**< Indexed by component ID, SparseSet storage types only. */
+        ComponentMask _tracked_removals;
+        std::atomic<u32> _change_tick{1};
 
-        usize _find_or_create_archetype(const std::vector<std::type_index> &types);
+        /** @brief Component masks of a despawn_all call, table components are tested per archetype, sparse ones per row. */
+        struct EntityFilter {
+                ComponentMask required;
+                ComponentMask excluded;
+                ComponentMask sparse_required;
+                ComponentMask sparse_excluded;
+        };
+
+        Entity _allocate_entity();
+        template<typename T>
+        void _insert_component(Entity e, T comp);
+        template<typename T>
+        void _erase_component(Entity e);
+        void _set_children(Entity parent, std::vector<Entity> children);
+        void _unparent(Entity child);
+        void _clear_children(Entity parent);
+        template<typename... Components>
+        void _link_placed(Entity e);
+        void _link_spawned_parent(Entity e);
+        void _link_spawned_children(Entity e);
+        void _despawn_matching(const EntityFilter &filter);
+        bool _sparse_matches(Entity e, const EntityFilter &filter) const noexcept;
+        void _claim_reserved(Entity e);
+        template<typename... Components>
+        void _place_bundle(Entity e, Components &...components);
+        template<typename... Components>
+        void _place_batch(const std::vector<Entity> &entities, std::vector<std::tuple<Components...>> &bundles);
+        void _record_removals(const Archetype &archetype, Entity e);
+        EntityLocation *_find_location(Entity e) noexcept;
+        template<typename... Components>
+        usize _find_or_create_bundle_archetype();
+        template<typename T>
+        SparseSet &_sparse_set_of();
+        usize _find_or_create_archetype(std::vector<const ComponentInfo *> infos);
         void _move_entity_between_archetypes(Entity e, EntityLocation &loc, usize new_archetype_idx);
 };
 
 }// namespace ecs
 
-#include "Inline/Scene.inl"
-
 }// namespace r
+
+#include "Inline/Scene.inl"
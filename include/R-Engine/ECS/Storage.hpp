@@ -4,90 +4,276 @@
 #include <R-Engine/R-EngineExport.hpp>
 #include <R-Engine/Types.hpp>
 
-#include <algorithm>
-#include <any>
-#include <atomic>
-#include <memory>
+#include <bitset>
+#include <limits>
+#include <type_traits>
 #include <typeindex>
-#include <unordered_map>
 #include <vector>
 
 namespace r::ecs {
 
+/** @name Component Identifiers */
+///@{
+
 /**
- * @brief Global atomic counter to generate unique type IDs.
- * @note This is not central to the archetype-based design but can be useful for other purposes.
+ * @brief Dense identifier of a component type, assigned in registration order starting at 0.
  */
-inline std::atomic<u64> g_type_counter{0u};
+using ComponentId = u32;
 
 /**
- * @brief Generates a unique, static ID for a given type T.
- * @tparam T The type to get an ID for.
- * @return A unique 64-bit integer ID.
+ * @brief Maximum number of distinct component types, bounds the width of archetype signatures.
  */
-template<typename T>
-static inline u64 type_id() noexcept
+inline constexpr usize MAX_COMPONENTS = 256;
+
+/**
+ * @brief Archetype signature, bit N is set when the component with ComponentId N is present.
+ */
+using ComponentMask = std::bitset<MAX_COMPONENTS>;
+
+/**
+ * @brief Checks if a change tick is more recent than the last run of a system.
+ * @details Ticks are compared relative to this_run so that the u32 counter can wrap around, ticks more
+ * than 2^31 runs old are no longer told apart reliably.
+ * @param tick The added or changed tick of a component.
+ * @param last_run The tick of the previous run of the system.
+ * @param this_run The tick of the current run of the system.
+ */
+constexpr bool is_tick_newer(u32 tick, u32 last_run, u32 this_run) noexcept
 {
-    static const u64 id = g_type_counter.fetch_add(1u, std::memory_order_relaxed);
-    return id;
+    return static_cast<u32>(this_run - tick) < static_cast<u32>(this_run - last_run);
 }
 
+/**
+ * @brief Sentinel stored in flat per-component lookup tables for an absent entry.
+ */
+inline constexpr u32 INVALID_INDEX = std::numeric_limits<u32>::max();
+
+/**
+ * @brief Registers a component type and returns its dense ID, the same type always yields the same ID.
+ * @details The registry lives in the engine library so IDs are shared across shared-library boundaries.
+ * @param type The type_index of the component.
+ * @return The dense ID of the component type.
+ * @throws r::exception::Error if more than MAX_COMPONENTS component types are registered.
+ */
+R_ENGINE_API ComponentId register_component_id(const std::type_index &type);
+
+/**
+ * @brief Gets the dense ID of a component type T.
+ * @details The ID is looked up once then cached, so this is a single static load on the hot path.
+ * @tparam T The component type.
+ * @return The dense ID of T.
+ * @throws r::exception::Error if T is not registered yet and MAX_COMPONENTS component types already are.
+ */
+template<typename T>
+ComponentId component_id();
+
+///@}
+
+/** @name Storage Policy */
+///@{
+
+/**
+ * @brief Where the components of a type are stored.
+ * @details Table components live in the columns of their archetype, adding or removing one moves the
+ * entity to another archetype. SparseSet components live in a per-type sparse set outside of the
+ * archetypes, adding or removing one is O(1) and never moves the other components of the entity,
+ * at the cost of a lookup per row when queried.
+ */
+enum class StorageType : u8 {
+    Table,
+    SparseSet
+};
+
+/**
+ * @brief Storage policy of a component type T, Table unless T declares otherwise.
+ * @details Declare it in the component:
+ * struct Hovered {
+ *     static constexpr r::ecs::StorageType storage = r::ecs::StorageType::SparseSet;
+ * };
+ */
+template<typename T, typename = void>
+struct component_storage {
+        static constexpr StorageType value = StorageType::Table;
+};
+
+template<typename T>
+struct component_storage<T, std::void_t<decltype(T::storage)>> {
+        static constexpr StorageType value = T::storage;
+};
+
+template<typename T>
+inline constexpr bool is_sparse_component_v = component_storage<T>::value == StorageType::SparseSet;
+
+///@}
+
 /** @name Table Storage Structures */
 ///@{
 
 /**
- * @brief Type-erased interface for a column of components (e.g., a std::vector<Position>).
- * @details This allows storing columns of different component types in a single collection.
+ * @brief Type descriptor of a component type, used to manipulate its values as raw bytes.
+ * @details One descriptor exists per component type, see component_info<T>().
+ */
+struct ComponentInfo {
+        std::type_index type;
+        ComponentId id;
+        usize size;
+        usize alignment;
+        void (*move_construct)(void *dst, void *src); /**< Move-constructs a T at dst from the T at src. */
+        void (*destroy)(void *ptr);                    /**< Destroys the T at ptr. */
+        bool trivially_relocatable;                    /**< A T can be moved with memcpy and needs no destruction. */
+        StorageType storage;                           /**< Storage policy of T, see component_storage. */
+};
+
+/**
+ * @brief Gets the type descriptor of a component type T.
+ * @tparam T The component type.
+ * @return A reference to the static descriptor of T.
+ * @throws r::exception::Error if T is not registered yet and MAX_COMPONENTS component types already are.
+ */
+template<typename T>
+const ComponentInfo &component_info();
+
+/**
+ * @brief A type-erased column of components stored as a contiguous byte blob.
+ * @details Elements are manipulated through the ComponentInfo of the column, trivially relocatable
+ * types are moved with memcpy and never destroyed.
  */
-struct R_ENGINE_API IColumn {
-        virtual ~IColumn() = default;
+struct R_ENGINE_API Column {
+    public:
+        explicit Column(const ComponentInfo *info) noexcept;
+        ~Column();
+
+        Column(const Column &) = delete;
+        Column &operator=(const Column &) = delete;
+        Column(Column &&other) noexcept;
+        Column &operator=(Column &&other) noexcept;
 
         /**
-         * @brief Adds a type-erased component to the end of the column.
-         * @param component The component to add, wrapped in std::any.
+         * @brief Move-constructs a component at the end of the column.
+         * @param component A pointer to the component to move from, its type must match the column type.
+         * @param tick The change tick the component is added at, used as both its added and changed tick.
          */
-        virtual void push_back(std::any component) = 0;
+        void push_move(void *component, u32 tick);
 
         /**
-         * @brief Removes a component by swapping it with the last element and popping.
+         * @brief Ensures the column can hold at least a given number of components without reallocating.
+         * @param capacity The minimum capacity.
+         */
+        void reserve(usize capacity);
+
+        /**
+         * @brief Removes a component by moving the last element into its slot and popping.
          * @param index The index of the component to remove.
          */
-        virtual void remove_swap_back(usize index) = 0;
+        void remove_swap_back(usize index);
+
+        /**
+         * @brief Destroys every component of the column, the capacity is kept.
+         */
+        void clear() noexcept;
 
         /**
          * @brief Gets a raw pointer to a component at a given index.
+         * @details Like a pointer, the column does not propagate its constness to the components.
          * @param index The index of the component.
          * @return A void pointer to the component data.
          */
-        virtual void *get_ptr(usize index) = 0;
+        void *get_ptr(usize index) const noexcept;
 
         /**
-         * @brief Moves a component from this column to another column.
+         * @brief Moves a component from this column to the end of another column of the same type.
+         * @details The source slot is left in a moved-from state, it is expected to be removed with remove_swap_back.
+         * The added and changed ticks of the component are carried over.
          * @param index The index of the component to move in the source column.
          * @param dest The destination column.
          */
-        virtual void move_to(usize index, IColumn &dest) = 0;
+        void move_to(usize index, Column &dest);
 
         /**
-         * @brief Creates a new, empty column of the same underlying type.
-         * @return A shared_ptr to the new IColumn.
+         * @brief Gets the tick at which each component was added, indexed by row.
+         * @details Like get_ptr, the column does not propagate its constness to the ticks.
          */
-        virtual std::shared_ptr<IColumn> clone_empty() const = 0;
+        u32 *added_ticks() const noexcept;
+
+        /**
+         * @brief Gets the tick at which each component was last mutably accessed, indexed by row.
+         * @details Like get_ptr, the column does not propagate its constness to the ticks.
+         */
+        u32 *changed_ticks() const noexcept;
+
+        /**
+         * @brief Gets the number of components in the column.
+         */
+        usize size() const noexcept;
+
+        /**
+         * @brief Gets the type descriptor of the column.
+         */
+        const ComponentInfo *info() const noexcept;
+
+    private:
+        const ComponentInfo *_info = nullptr;
+        u8 *_data = nullptr;
+        usize _size = 0;
+        usize _capacity = 0;
+        std::vector<u32> _added_ticks;
+        std::vector<u32> _changed_ticks;
+
+        void _grow(usize min_capacity);
+        void _release() noexcept;
 };
 
 /**
- * @brief A typed implementation of a component column, using a std::vector for storage.
- * @tparam T The component type.
+ * @brief Stores the components of a SparseSet storage type, outside of the archetype tables.
+ * @details Components are packed in a dense column, a sparse array indexed by entity index maps an
+ * entity to its dense slot. The dense array keeps the full entity handle so stale handles are rejected.
  */
-template<typename T>
-struct Column : IColumn {
-        std::vector<T> data;
-
-        void push_back(std::any component) override;
-        void remove_swap_back(usize index) override;
-        void *get_ptr(usize index) override;
-        void move_to(usize index, IColumn &dest) override;
-        std::shared_ptr<IColumn> clone_empty() const override;
+struct R_ENGINE_API SparseSet {
+    public:
+        explicit SparseSet(const ComponentInfo *info) noexcept;
+
+        /**
+         * @brief Gets the dense slot of an entity.
+         * @param e The entity to look up.
+         * @return The dense slot, or INVALID_INDEX if the entity has no component in this set.
+         */
+        u32 dense_index(Entity e) const noexcept;
+
+        /**
+         * @brief Checks if an entity has a component in this set.
+         */
+        bool contains(Entity e) const noexcept;
+
+        /**
+         * @brief Move-constructs the component of an entity into the set.
+         * @details The entity must not already be in the set.
+         * @param e The entity owning the component.
+         * @param component A pointer to the component to move from.
+         * @param tick The change tick the component is added at.
+         */
+        void insert(Entity e, void *component, u32 tick);
+
+        /**
+         * @brief Removes the component of an entity by moving the last dense element into its slot.
+         * @param e The entity to remove.
+         * @return True if the entity was in the set, false otherwise.
+         */
+        bool remove(Entity e);
+
+        /**
+         * @brief Gets the dense column holding the components, indexed by dense slot.
+         */
+        const Column &column() const noexcept;
+
+        /**
+         * @brief Gets the entities of the set, indexed by dense slot.
+         */
+        const std::vector<Entity> &entities() const noexcept;
+
+    private:
+        Column _dense;
+        std::vector<Entity> _entities;
+        std::vector<u32> _sparse; /**< Indexed by entity index, INVALID_INDEX when absent. */
 };
 
 /**
@@ -96,7 +282,7 @@ struct Column : IColumn {
  */
 struct R_ENGINE_API Table {
         std::vector<Entity> entities;
-        std::vector<std::shared_ptr<IColumn>> columns;
+        std::vector<Column> columns;
 
         /**
          * @brief Adds an entity to the table.
@@ -110,6 +296,10 @@ struct R_ENGINE_API Table {
          * @return The ID of the entity that was swapped into the removed row, or 0 if no swap occurred.
          */
         Entity remove_entity_swap_back(usize row);
+        /**
+         * @brief Removes every entity of the table at once, the capacity of the columns is kept.
+         */
+        void clear() noexcept;
 };
 
 /**
@@ -117,22 +307,46 @@ struct R_ENGINE_API Table {
  * @details An archetype groups all entities that have the exact same set of components.
  */
 struct R_ENGINE_API Archetype {
-        std::vector<std::type_index> component_types;
-        std::unordered_map<std::type_index, usize> component_map; /**< Maps component type to column index in the table. */
+        ComponentMask mask;                     /**< Signature of the archetype, one bit per component ID. */
+        std::vector<ComponentId> component_ids; /**< Component IDs in column order, sorted ascending. */
+        std::vector<u32> component_map;         /**< Maps a component ID to its column index in the table, or INVALID_INDEX. */
         Table table;
 
-        /** @brief Caching for archetype transitions. */
+        /** @brief Caching for archetype transitions, indexed by component ID, INVALID_INDEX when not cached yet. */
         ///@{
-        std::unordered_map<std::type_index, usize> add_edge;
-        std::unordered_map<std::type_index, usize> remove_edge;
+        std::vector<u32> add_edge;
+        std::vector<u32> remove_edge;
         ///@}
 
         /**
          * @brief Checks if this archetype contains a specific component type.
-         * @param type The type_index of the component.
+         * @param id The ID of the component.
          * @return True if the component is part of the archetype, false otherwise.
          */
-        bool has_component(const std::type_index &type) const;
+        bool has_component(ComponentId id) const noexcept;
+
+        /**
+         * @brief Gets the column index of a component type in the table.
+         * @param id The ID of the component.
+         * @return The column index, or INVALID_INDEX if the component is not part of the archetype.
+         */
+        u32 column_index(ComponentId id) const noexcept;
+
+        /**
+         * @brief Gets a cached archetype transition.
+         * @param edges Either add_edge or remove_edge.
+         * @param id The ID of the added or removed component.
+         * @return The destination archetype index, or INVALID_INDEX if the transition is not cached.
+         */
+        static u32 get_edge(const std::vector<u32> &edges, ComponentId id) noexcept;
+
+        /**
+         * @brief Caches an archetype transition.
+         * @param edges Either add_edge or remove_edge.
+         * @param id The ID of the added or removed component.
+         * @param archetype_idx The destination archetype index.
+         */
+        static void set_edge(std::vector<u32> &edges, ComponentId id, usize archetype_idx);
 };
 
 ///@}
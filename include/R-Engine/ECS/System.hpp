@@ -7,6 +7,7 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <variant>
 
 #ifndef R_UNUSED
     #if defined(_MSC_VER)
@@ -88,9 +89,69 @@ struct function_traits<R (*)(Args...) noexcept> {
         using args = std::tuple<std::remove_cvref_t<Args>...>;
 };
 
+/**
+ * @brief persistent state of a single system parameter.
+ * @details built once when the system is added. Query<...> parameters keep a QueryState, resource and event
+ * parameters keep their resource pointer, revalidated only when the archetype or resource generation of the
+ * scene changed. EventReader<T> parameters also keep their cursor. Every other parameter is stateless.
+ */
+template<typename T>
+struct system_param_state {
+        using type = std::monostate;
+};
+
+template<typename... Wrappers>
+struct system_param_state<Query<Wrappers...>> {
+        using type = QueryState;
+};
+
+template<typename T>
+struct system_param_state<Res<T>> {
+        using type = ResourceState;
+};
+
+template<typename T>
+struct system_param_state<ResMut<T>> {
+        using type = ResourceState;
+};
+
+template<typename T>
+struct system_param_state<EventWriter<T>> {
+        using type = ResourceState;
+};
+
+template<typename T>
+struct system_param_state<EventReader<T>> {
+        using type = EventReaderState;
+};
+
+/**
+ * @brief persistent state of a system, one slot per parameter of its signature.
+ * @details owned by the SystemNode and handed back to the system on every run.
+ * last_run is the change tick of the previous run, used by Added<T> / Changed<T> filters.
+ */
+template<typename ArgsTuple>
+struct SystemState;
+
+template<typename... Args>
+struct SystemState<std::tuple<Args...>> {
+        std::tuple<typename system_param_state<Args>::type...> params;
+        u32 last_run = 0;
+};
+
+template<typename Func>
+using system_state_t = SystemState<typename function_traits<std::remove_cvref_t<Func>>::args>;
+
 template<auto Func>
 void get_system_access(sys::Access &comp_access, sys::Access &res_access);
 
+/**
+ * @brief prepares the scene for the parameters of a system, called once when the system is added.
+ * @details e.g. a RemovedComponents<T> parameter turns on removal tracking for T.
+ */
+template<typename Func>
+void init_system_params(Scene &scene);
+
 /**
  * @brief invoke a system function with arguments resolved from the ECS Scene.
  *
@@ -101,7 +162,20 @@ void get_system_access(sys::Access &comp_access, sys::Access &res_access);
  * @param args argument types (deduced from function_traits)
  */
 template<typename Func, typename... Args, size_t... I>
-static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd, std::tuple<Args...>, std::index_sequence<I...>);
+static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd, std::type_identity<std::tuple<Args...>>,
+    std::index_sequence<I...>);
+
+/**
+ * @brief invoke a system function with arguments resolved from the ECS Scene and its persistent state.
+ *
+ * same as `call_with_resolved`, but stateful parameters (Query<...>) reuse the matching cached
+ * in the system state instead of testing every archetype of the scene again.
+ *
+ * @param state the persistent state of the system
+ */
+template<typename Func, typename State, typename... Args, size_t... I>
+static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd, State &state,
+    std::type_identity<std::tuple<Args...>>, std::index_sequence<I...>);
 
 /**
  * @brief invoke a predicate function with arguments resolved from the ECS Scene.
@@ -113,8 +187,8 @@ static inline auto call_with_resolved(Func &&f, Scene &scene, CommandBuffer &cmd
  * @return the boolean result of the predicate.
  */
 template<typename Predicate, typename... Args, size_t... I>
-static inline bool call_predicate_with_resolved(Predicate &&p, Scene &scene, CommandBuffer &cmd, std::tuple<Args...>,
-    std::index_sequence<I...>);
+static inline bool call_predicate_with_resolved(Predicate &&p, Scene &scene, CommandBuffer &cmd,
+    std::type_identity<std::tuple<Args...>>, std::index_sequence<I...>);
 
 /**
  * @brief entry point to execute a system.
@@ -130,6 +204,13 @@ static inline bool call_predicate_with_resolved(Predicate &&p, Scene &scene, Com
 template<typename Func>
 static inline void run_system(Func &&f, Scene &scene, CommandBuffer &cmd);
 
+/**
+ * @brief entry point to execute a system with its persistent state.
+ * @param state the state owned by the system node, created once when the system is added.
+ */
+template<typename Func>
+static inline void run_system(Func &&f, Scene &scene, CommandBuffer &cmd, system_state_t<Func> &state);
+
 }// namespace ecs
 
 }// namespace r
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <R-Engine/Components/Material3d.hpp>
 #include <R-Engine/Components/Transform3d.hpp>
 #include <R-Engine/Core/Backend.hpp>
 #include <R-Engine/Plugins/Plugin.hpp>
@@ -203,6 +204,26 @@ struct R_ENGINE_API Mesh3d final {
         r::Vec3f scale_offset = {1.f, 1.f, 1.f};
 };
 
+/**
+ * @brief Mesh draws extracted from the scene during EXTRACT, at the end of the frame, used in pipelined mode.
+ * @details See Application::set_pipelined. The mesh renderer draws from this copy instead of querying
+ * Mesh3d, GlobalTransform3d and Material3d, so neither the start of the next frame nor its UPDATE
+ * changes what is drawn.
+ */
+struct R_ENGINE_API MeshSnapshot final {
+        static constexpr inline u32 NO_MATERIAL = static_cast<u32>(-1);
+
+        struct Draw {
+                MeshHandle id = MeshInvalidHandle;
+                Color color;
+                Transform3d transform;
+                u32 material = NO_MATERIAL; /**< Index in materials. */
+        };
+
+        std::vector<Draw> draws;
+        std::vector<Material3d> materials;
+};
+
 /**
 * @brief Mesh Plugin for R-Engine
 * @details provides mesh components and systems
@@ -4,6 +4,13 @@
 
 namespace r {
 
+/**
+ * @brief system set of the transform propagation, which runs in the EXTRACT schedule
+ * @details systems of EXTRACT reading GlobalTransform3d go after<TransformPropagationSet>().
+ */
+struct TransformPropagationSet {
+};
+
 class R_ENGINE_API TransformPlugin final : public Plugin
 {
     public:
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <R-Engine/Core/Backend.hpp>
+#include <R-Engine/Core/Extracted.hpp>
 #include <R-Engine/ECS/Command.hpp>
 #include <R-Engine/ECS/Event.hpp>
 #include <R-Engine/ECS/Query.hpp>
@@ -78,7 +79,7 @@ void scroll_clamp_system(r::ecs::Query<r::ecs::Mut<r::UiScroll>, r::ecs::Ref<r::
 /**
  * @brief Issue draw calls (background, borders, images, text, debug overlay, scrollbars).
  */
-void render_system(r::ecs::Res<UiPluginConfig> cfg, r::ecs::Res<r::Camera3d> cam, r::ecs::Res<r::UiInputState> input,
+void render_system(r::ecs::Res<UiPluginConfig> cfg, r::ecs::Res<r::core::Extracted<r::Camera3d>> cam, r::ecs::Res<r::UiInputState> input,
     r::ecs::Res<r::UiTheme> theme, r::ecs::ResMut<r::UiTextures> textures, r::ecs::ResMut<r::UiFonts> fonts,
     r::ecs::Query<r::ecs::Ref<r::UiNode>, r::ecs::Ref<r::ComputedLayout>, r::ecs::Optional<r::Style>, r::ecs::Optional<r::Visibility>,
         r::ecs::Optional<r::ecs::Parent>, r::ecs::Optional<r::UiText>, r::ecs::Optional<r::UiImage>, r::ecs::Optional<r::UiButton>,
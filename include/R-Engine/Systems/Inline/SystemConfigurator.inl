@@ -75,48 +75,30 @@ r::sys::SystemConfigurator &r::sys::SystemConfigurator::before() noexcept
 template<auto PredicateFunc>
 r::sys::SystemConfigurator &r::sys::SystemConfigurator::run_if() noexcept
 {
-    _current_condition = _create_condition_wrapper<PredicateFunc>();
-    _apply_condition();
+    _conditions.clear();
+    _push_condition<PredicateFunc>(RunCondition::Join::And, false);
     return *this;
 }
 
 template<auto PredicateFunc>
 r::sys::SystemConfigurator &r::sys::SystemConfigurator::run_and() noexcept
 {
-    const auto new_condition = _create_condition_wrapper<PredicateFunc>();
-
-    if (_current_condition) {
-        _current_condition = [old_cond = _current_condition, new_cond = new_condition](
-                                 ecs::Scene &scene) { return old_cond(scene) && new_cond(scene); };
-    } else {
-        _current_condition = new_condition;
-    }
-
-    _apply_condition();
+    _push_condition<PredicateFunc>(RunCondition::Join::And, false);
     return *this;
 }
 
 template<auto PredicateFunc>
 r::sys::SystemConfigurator &r::sys::SystemConfigurator::run_or() noexcept
 {
-    const auto new_condition = _create_condition_wrapper<PredicateFunc>();
-
-    if (_current_condition) {
-        _current_condition = [old_cond = _current_condition, new_cond = new_condition](
-                                 ecs::Scene &scene) { return old_cond(scene) || new_cond(scene); };
-    } else {
-        _current_condition = new_condition;
-    }
-
-    _apply_condition();
+    _push_condition<PredicateFunc>(RunCondition::Join::Or, false);
     return *this;
 }
 
 template<auto PredicateFunc>
 r::sys::SystemConfigurator &r::sys::SystemConfigurator::run_unless() noexcept
 {
-    _current_condition = _create_condition_wrapper<PredicateFunc>(true);
-    _apply_condition();
+    _conditions.clear();
+    _push_condition<PredicateFunc>(RunCondition::Join::And, true);
     return *this;
 }
 
@@ -125,23 +107,33 @@ r::sys::SystemConfigurator &r::sys::SystemConfigurator::run_unless() noexcept
  */
 
 template<auto PredicateFunc>
-auto r::sys::SystemConfigurator::_create_condition_wrapper(bool negated) -> std::function<bool(ecs::Scene &)>
+bool r::sys::SystemConfigurator::_evaluate_predicate(ecs::Scene &scene, ecs::CommandBuffer &cmd)
 {
     using traits = ecs::function_traits<std::remove_cvref_t<decltype(PredicateFunc)>>;
     using args = typename traits::args;
 
-    return [app = this->_app, negated](ecs::Scene &scene) -> bool {
-        bool result = ecs::call_predicate_with_resolved(PredicateFunc, scene, app->_command_buffer, args{},
-            std::make_index_sequence<std::tuple_size_v<args>>{});
+    return ecs::call_predicate_with_resolved(PredicateFunc, scene, cmd, std::type_identity<args>{}, std::make_index_sequence<std::tuple_size_v<args>>{});
+}
+
+template<auto PredicateFunc>
+void r::sys::SystemConfigurator::_push_condition(RunCondition::Join join, bool negated)
+{
+    _conditions.push_back({&_evaluate_predicate<PredicateFunc>, join, negated});
+    _apply_condition();
 
-        return negated ? !result : result;
-    };
+    /* the predicate runs once its system is released, possibly next to other systems, so it shares its access */
+    for (const auto &system_id : _system_ids) {
+        auto &node = _graph->nodes.at(system_id);
+
+        ecs::get_system_access<PredicateFunc>(node.component_access, node.resource_access);
+    }
+    _graph->dirty = true;
 }
 
 inline void r::sys::SystemConfigurator::_apply_condition()
 {
     for (const auto &system_id : _system_ids) {
-        _graph->nodes.at(system_id).condition = _current_condition;
+        _graph->nodes.at(system_id).conditions = _conditions;
     }
 }
 
@@ -3,6 +3,7 @@
 #include <R-Engine/ECS/Command.hpp>
 #include <R-Engine/ECS/Scene.hpp>
 
+#include <memory>
 #include <string>
 #include <typeindex>
 #include <unordered_map>
@@ -32,7 +33,25 @@ struct SystemSetTag {
 
 using SystemTypeId = std::type_index;
 using SystemSetId = std::type_index;
-using SystemFn = void (*)(ecs::Scene &, ecs::CommandBuffer &);
+using SystemFn = void (*)(ecs::Scene &, ecs::CommandBuffer &, void *state);
+using ConditionFn = bool (*)(ecs::Scene &, ecs::CommandBuffer &);
+
+/**
+ * @brief One predicate of the run condition of a system.
+ * @details A run condition is a flat list folded left to right, each predicate joined to the result of the
+ * ones before it: run_if<a>().run_and<b>().run_or<c>() is ((a && b) || c). A predicate whose result cannot
+ * change the outcome is not evaluated.
+ */
+struct RunCondition {
+        enum class Join : u8 {
+            And,
+            Or
+        };
+
+        ConditionFn predicate = nullptr;
+        Join join = Join::And;
+        bool negated = false;
+};
 
 struct Access {
         std::unordered_set<std::type_index> reads;
@@ -46,14 +65,24 @@ struct R_ENGINE_API SystemNode {
         std::string name;
         SystemTypeId id;
         SystemFn func = nullptr;
+        std::shared_ptr<void> state = nullptr; /**< Persistent parameter state (ecs::SystemState) handed to func on every run. */
         std::vector<SystemTypeId> dependencies;
-        std::function<bool(ecs::Scene &)> condition = nullptr;
+        std::vector<RunCondition> conditions; /**< Empty when the system always runs. */
         std::vector<SystemSetId> member_of_sets;
         std::vector<SystemSetId> after_sets;
         std::vector<SystemSetId> before_sets;
         Access component_access;
         Access resource_access;
         bool is_main_thread_only = false;
+
+        /**
+         * @brief Evaluates the run condition of the system.
+         * @details Called by the scheduler right before the system runs, on the thread that runs it.
+         * @param scene The scene the predicates read from.
+         * @param cmd The command buffer handed to the predicates.
+         * @return true if the system has no run condition or if it holds.
+         */
+        bool should_run(ecs::Scene &scene, ecs::CommandBuffer &cmd) const;
 };
 
 /**
@@ -70,10 +99,27 @@ struct R_ENGINE_API SystemSet {
         std::vector<SystemSetId> after_sets;
 };
 
+/**
+ * @brief A system of the compiled schedule, with the systems waiting on it.
+ * @details There is an edge from a system to a later one (in dispatch order) when an ordering constraint
+ * links them, when their accesses conflict, or when both are main thread only. predecessors is the number
+ * of incoming edges, a system is started as soon as that many systems completed, without waiting for the
+ * rest of its stage. When several systems become ready together, the highest rank is started first.
+ */
+struct ScheduledSystem {
+        const SystemNode *node = nullptr;
+        std::vector<u32> successors; /**< Sorted by increasing rank. */
+        u32 predecessors = 0;
+        f64 rank = 0.0;              /**< Measured time in µs from the start of the system to the end of the graph, on its longest path. */
+};
+
 struct ScheduleGraph {
         std::unordered_map<SystemTypeId, SystemNode> nodes;
         std::unordered_map<SystemSetId, SystemSet> sets;
         std::vector<std::vector<const SystemNode *>> execution_stages;
+        std::vector<ScheduledSystem> dag; /**< execution_stages flattened in dispatch order, with their edges. */
+        u64 version = 0;                  /**< Bumped every time the dag is rebuilt. */
+        u32 runs_since_ranking = 0;       /**< The ranks of the dag are refreshed periodically from the measured times. */
         bool dirty = true;
 };
 
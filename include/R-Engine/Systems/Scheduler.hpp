@@ -23,6 +23,7 @@ namespace sys {
 
 struct ScheduleGraph;
 struct SystemNode;
+struct ScheduledSystem;
 using SystemTypeId = std::type_index;
 
 }// namespace sys
@@ -37,13 +38,19 @@ class ThreadPool;
 /**
  * @brief Manages the sorting and execution of systems within a ScheduleGraph.
  * @details This class encapsulates the logic for topological sorting of system dependencies
- * and executing the resulting stages, utilizing a thread pool for parallel systems.
+ * and compiling the result into a DAG whose edges come from ordering constraints and access conflicts.
+ * Each system is started on the thread pool once its own predecessors completed, tracked with atomic
+ * in-degree counters. Main thread only systems are handed back to the thread calling run(), which runs
+ * them in order while the workers keep running the systems they do not conflict with.
  */
 class R_ENGINE_API Scheduler final
 {
     public:
         explicit Scheduler(ThreadPool &thread_pool);
-        ~Scheduler() = default;
+        ~Scheduler();
+
+        Scheduler(const Scheduler &) = delete;
+        Scheduler &operator=(const Scheduler &) = delete;
 
         /**
          * @brief Runs all systems in a given schedule graph.
@@ -56,10 +63,44 @@ class R_ENGINE_API Scheduler final
             const std::vector<std::unique_ptr<ecs::CommandBuffer>> &thread_local_buffers
         );
 
+        /**
+         * @brief Runs several schedules back to back as a single graph.
+         * @details Meant for schedules with no command application between them: a system of a later
+         * schedule only waits for the systems of earlier schedules it conflicts with, and main thread only
+         * systems keep the order of their schedules. The compiled chain is cached until a graph is re-sorted.
+         */
+        void run_chain(
+            const std::vector<sys::ScheduleGraph *> &graphs,
+            ecs::Scene &scene,
+            ecs::CommandBuffer &main_command_buffer,
+            const std::vector<std::unique_ptr<ecs::CommandBuffer>> &thread_local_buffers
+        );
+
+        /**
+         * @brief Gets the exponential moving average of the run time of a system, in µs.
+         * @details Includes its run condition, 0 for a system that never ran.
+         */
+        f64 get_average_run_time(const sys::SystemTypeId &id) const noexcept;
+
     private:
+        struct Execution;
+
+        /**
+         * @brief Schedules compiled together by run_chain, with the graph versions they were built from.
+         */
+        struct Chain {
+                std::vector<const sys::ScheduleGraph *> graphs;
+                std::vector<u64> versions;
+                std::vector<sys::ScheduledSystem> dag;
+                u32 runs_since_ranking = 0;
+        };
+
         void _sort_graph(sys::ScheduleGraph &graph);
-        void _execute_graph(
-            const sys::ScheduleGraph &graph,
+        void _build_chain(Chain &chain, const std::vector<sys::ScheduleGraph *> &graphs);
+        void _prioritize(std::vector<sys::ScheduledSystem> &dag, u32 &runs_since_ranking) const;
+        void _record_run_times(const std::vector<sys::ScheduledSystem> &dag);
+        void _execute(
+            const std::vector<sys::ScheduledSystem> &dag,
             ecs::Scene &scene,
             ecs::CommandBuffer &main_command_buffer,
             const std::vector<std::unique_ptr<ecs::CommandBuffer>> &thread_local_buffers
@@ -83,6 +124,10 @@ class R_ENGINE_API Scheduler final
         );
 
         ThreadPool &_thread_pool;
+        std::vector<Chain> _chains;
+        std::unordered_map<sys::SystemTypeId, f64> _run_times; /**< Moving average of the run time of each system, in µs. */
+        std::unique_ptr<Execution> _execution; /**< State of the running graph, reused across runs. */
+        u64 _next_source = 1; /**< Dispatch index of the next system run, orders the commands it records. */
 };
 
 }// namespace core
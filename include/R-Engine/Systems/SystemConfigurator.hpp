@@ -104,10 +104,13 @@ class SystemConfigurator final : public ConfiguratorBase<SystemConfigurator>
         ScheduleGraph *_graph;
         std::vector<SystemTypeId> _system_ids;
 
-        std::function<bool(r::ecs::Scene &)> _current_condition;
+        std::vector<RunCondition> _conditions;
 
         template<auto PredicateFunc>
-        auto _create_condition_wrapper(bool negated = false) -> std::function<bool(ecs::Scene &)>;
+        static bool _evaluate_predicate(ecs::Scene &scene, ecs::CommandBuffer &cmd);
+
+        template<auto PredicateFunc>
+        void _push_condition(RunCondition::Join join, bool negated);
 
         void _apply_condition();
 };
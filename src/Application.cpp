@@ -4,6 +4,8 @@
 #include <R-Engine/Core/Logger.hpp>
 #include <R-Engine/Core/ThreadPool.hpp>
 
+#include <algorithm>
+#include <array>
 #include <csignal>
 #include <iostream>
 #include <thread>
@@ -19,6 +21,7 @@ r::Application::Application()
 
     _thread_pool = std::make_unique<core::ThreadPool>(thread_count > 0 ? thread_count : 1);
     _scheduler = std::make_unique<core::Scheduler>(*_thread_pool);
+    _scene.set_thread_pool(_thread_pool.get());
 
     _prepare_thread_local_buffers(thread_count > 0 ? thread_count : 1);
 
@@ -45,24 +48,29 @@ void r::Application::init()
     _startup();
 }
 
-void r::Application::tick()
+r::Application &r::Application::set_pipelined(const bool pipelined) noexcept
 {
-    _clock.tick();
-    *_scene.get_resource_ptr<core::FrameTime>() = _clock.frame();
+    _pipelined = pipelined;
+    return *this;
+}
 
-    _apply_state_transitions();
+bool r::Application::is_pipelined() const noexcept
+{
+    return _pipelined;
+}
+
+void r::Application::tick()
+{
+    _begin_frame();
 
     _run_schedule(Schedule::UPDATE);
 
     _apply_commands();
-
-    for (i32 i = 0; i < _clock.frame().substep_count; ++i) {
-        _run_schedule(Schedule::FIXED_UPDATE);
-        _apply_commands();
-    }
+    _run_fixed_updates();
 
     _run_schedule(Schedule::EVENT_CLEANUP);
     _apply_commands();
+    _scene.update_removed_components();
 }
 
 /**
@@ -72,6 +80,7 @@ void r::Application::tick()
 void r::Application::_startup()
 {
     _scene.insert_resource(_clock.frame());
+    _scene.insert_resource(core::Extracted<core::FrameTime>{_clock.frame()});
 
     Logger::debug("Pre-startup schedule running...");
     _run_schedule(Schedule::PRE_STARTUP);
@@ -97,22 +106,49 @@ void r::Application::_startup()
 
 void r::Application::_main_loop()
 {
-    while (!quit) {
-        _clock.tick();
-        *_scene.get_resource_ptr<core::FrameTime>() = _clock.frame();
-
-        _apply_state_transitions();
-
-        _run_schedule(Schedule::UPDATE);
-        _apply_commands();
-
-        for (i32 i = 0; i < _clock.frame().substep_count; ++i) {
-            _run_schedule(Schedule::FIXED_UPDATE);
+    if (!_pipelined) {
+        while (!quit) {
+            _begin_frame();
+            _run_schedule(Schedule::UPDATE);
             _apply_commands();
+            _run_fixed_updates();
+            _extract_frame();
+            _render_routine(false);
+            _scene.update_removed_components();
         }
-        _render_routine();
-        _run_schedule(Schedule::EVENT_CLEANUP);
+        return;
     }
+
+    /**
+    * @info pipelined: the UPDATE of frame N + 1 is part of the render graph of frame N, which only reads
+    * what EXTRACT copied at the end of frame N. commands are still applied at the same points, render
+    * commands were already only applied after the next UPDATE.
+    * state transitions change the world before the UPDATE, so those frames are not overlapped.
+    */
+    _begin_frame();
+    _run_schedule(Schedule::UPDATE);
+    _apply_commands();
+    _run_fixed_updates();
+    while (!quit) {
+        _extract_frame();
+        if (_has_pending_transition()) {
+            _render_routine(false);
+            _scene.update_removed_components();
+            _begin_frame();
+            _run_schedule(Schedule::UPDATE);
+        } else {
+            _scene.update_removed_components();
+            _begin_frame();
+            _render_routine(true);
+        }
+        _apply_commands();
+        _run_fixed_updates();
+    }
+
+    /* the last simulated frame has no next UPDATE to overlap, it is drawn like in the default loop */
+    _extract_frame();
+    _render_routine(false);
+    _scene.update_removed_components();
 }
 
 void r::Application::_shutdown()
@@ -128,6 +164,36 @@ void r::Application::_shutdown()
 * private
 */
 
+void r::Application::_begin_frame()
+{
+    _clock.tick();
+    *_scene.get_resource_ptr<core::FrameTime>() = _clock.frame();
+
+    _apply_state_transitions();
+}
+
+void r::Application::_run_fixed_updates()
+{
+    for (i32 i = 0; i < _clock.frame().substep_count; ++i) {
+        _run_schedule(Schedule::FIXED_UPDATE);
+        _apply_commands();
+    }
+}
+
+/**
+* @brief runs EXTRACT and copies the FrameTime of the frame for its render
+*/
+void r::Application::_extract_frame()
+{
+    _scene.get_resource_ptr<core::Extracted<core::FrameTime>>()->value = *_scene.get_resource_ptr<core::FrameTime>();
+    _run_schedule(Schedule::EXTRACT);
+}
+
+bool r::Application::_has_pending_transition() const
+{
+    return std::any_of(_state_transition_pending.begin(), _state_transition_pending.end(), [](const auto &pending) { return pending(); });
+}
+
 void r::Application::_run_schedule(const Schedule sched)
 {
     const auto it = _systems.find(sched);
@@ -141,25 +207,41 @@ void r::Application::_run_schedule(const Schedule sched)
     _scheduler->run(graph, _scene, _command_buffer, _thread_local_command_buffers);
 }
 
-void r::Application::_render_routine()
+/**
+* @brief runs the render schedules, then EVENT_CLEANUP, then the UPDATE of the next frame if asked to
+* @details no command is applied in between, so they run as one chain: the parallel systems of
+* EVENT_CLEANUP and UPDATE start on the workers while the main thread is still rendering, unless they conflict.
+*/
+void r::Application::_render_routine(const bool with_next_update)
 {
-    _run_schedule(Schedule::BEFORE_RENDER_2D);
-    _run_schedule(Schedule::BEFORE_RENDER_3D);
-
-    _run_schedule(Schedule::RENDER_3D);
-
-    _run_schedule(Schedule::AFTER_RENDER_3D);
-    _run_schedule(Schedule::RENDER_2D);
+    static constexpr std::array<Schedule, 8> chain = {{
+        Schedule::BEFORE_RENDER_2D,
+        Schedule::BEFORE_RENDER_3D,
+        Schedule::RENDER_3D,
+        Schedule::AFTER_RENDER_3D,
+        Schedule::RENDER_2D,
+        Schedule::AFTER_RENDER_2D,
+        Schedule::EVENT_CLEANUP,
+        Schedule::UPDATE,
+    }};
+
+    _render_chain.clear();
+    for (const Schedule sched : chain) {
+        if (sched == Schedule::UPDATE && !with_next_update) {
+            continue;
+        }
+        const auto it = _systems.find(sched);
 
-    _run_schedule(Schedule::AFTER_RENDER_2D);
+        if (it != _systems.end() && !it->second.nodes.empty()) {
+            _render_chain.push_back(&it->second);
+        }
+    }
+    _scheduler->run_chain(_render_chain, _scene, _command_buffer, _thread_local_command_buffers);
 }
 
 void r::Application::_apply_commands()
 {
-    _command_buffer.apply(_scene);
-    for (auto &buffer : _thread_local_command_buffers) {
-        buffer->apply(_scene);
-    }
+    ecs::CommandBuffer::apply_merged(_scene, _command_buffer, _thread_local_command_buffers);
 }
 
 void r::Application::_apply_state_transitions()
@@ -183,6 +265,6 @@ void r::Application::_run_transition_schedule(sys::ScheduleGraph &graph)
 void r::Application::_prepare_thread_local_buffers(size_t count)
 {
     for (size_t i = 0; i < count; ++i) {
-        _thread_local_command_buffers.push_back(std::make_unique<ecs::CommandBuffer>());
+        _thread_local_command_buffers.push_back(std::make_unique<ecs::CommandBuffer>(&_scene));
     }
 }
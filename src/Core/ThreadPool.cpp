@@ -1,45 +1,359 @@
 #include <R-Engine/Core/ThreadPool.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace {
+
+/* rounds of stealing attempts an idle worker makes before parking */
+constexpr u32 SPIN_ROUNDS = 64;
+constexpr i64 INITIAL_DEQUE_CAPACITY = 256;
+constexpr size_t CACHE_LINE = 64;
+
+/* the pool and worker index of the current thread, the pool is null outside of workers */
+thread_local const r::core::ThreadPool *tl_pool = nullptr;
+thread_local size_t tl_worker = 0;
+
+void run_task(r::core::detail::Task *task) noexcept
+{
+    task->run(task);
+    task->release();
+}
+
+}// namespace
+
+/**
+* @brief Chase-Lev work-stealing deque of tasks
+* @details the owner pushes and pops at the bottom, thieves take from the top and only race with the
+* owner on the last task. the ring grows by doubling, retired rings are kept until the deque dies
+* because a thief may still be reading from one.
+* see "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al., PPoPP 2013.
+*/
+struct r::core::ThreadPool::Deque {
+        struct Ring {
+                explicit Ring(i64 cap) : capacity(cap), slots(std::make_unique<std::atomic<detail::Task *>[]>(static_cast<size_t>(cap)))
+                {
+                    /* __ctor__ */
+                }
+
+                detail::Task *get(i64 i) const noexcept
+                {
+                    return slots[static_cast<size_t>(i & (capacity - 1))].load(std::memory_order_relaxed);
+                }
+
+                void put(i64 i, detail::Task *task) noexcept
+                {
+                    slots[static_cast<size_t>(i & (capacity - 1))].store(task, std::memory_order_relaxed);
+                }
+
+                i64 capacity;
+                std::unique_ptr<std::atomic<detail::Task *>[]> slots;
+        };
+
+        Deque()
+        {
+            _rings.push_back(std::make_unique<Ring>(INITIAL_DEQUE_CAPACITY));
+            _ring.store(_rings.back().get(), std::memory_order_relaxed);
+        }
+
+        void push(detail::Task *task)
+        {
+            const i64 b = _bottom.load(std::memory_order_relaxed);
+            const i64 t = _top.load(std::memory_order_acquire);
+            Ring *ring = _ring.load(std::memory_order_relaxed);
+
+            if (b - t > ring->capacity - 1) {
+                ring = _grow(ring, t, b);
+            }
+            ring->put(b, task);
+            std::atomic_thread_fence(std::memory_order_release);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        detail::Task *pop() noexcept
+        {
+            const i64 b = _bottom.load(std::memory_order_relaxed) - 1;
+            Ring *ring = _ring.load(std::memory_order_relaxed);
+
+            _bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            i64 t = _top.load(std::memory_order_relaxed);
+
+            if (t > b) {
+                _bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            detail::Task *task = ring->get(b);
+
+            if (t == b) {
+                /* last task, race the thieves for it */
+                if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    task = nullptr;
+                }
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return task;
+        }
+
+        /**
+        * @brief takes the oldest task, contended is set when another thread won the race for it
+        */
+        detail::Task *steal(bool &contended) noexcept
+        {
+            i64 t = _top.load(std::memory_order_acquire);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            const i64 b = _bottom.load(std::memory_order_acquire);
+
+            if (t >= b) {
+                return nullptr;
+            }
+
+            detail::Task *task = _ring.load(std::memory_order_acquire)->get(t);
+
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                contended = true;
+                return nullptr;
+            }
+            return task;
+        }
+
+    private:
+        Ring *_grow(const Ring *old, i64 t, i64 b)
+        {
+            auto ring = std::make_unique<Ring>(old->capacity * 2);
+
+            for (i64 i = t; i < b; ++i) {
+                ring->put(i, old->get(i));
+            }
+            _rings.push_back(std::move(ring));
+            _ring.store(_rings.back().get(), std::memory_order_release);
+            return _rings.back().get();
+        }
+
+        alignas(CACHE_LINE) std::atomic<i64> _top{0};
+        alignas(CACHE_LINE) std::atomic<i64> _bottom{0};
+        alignas(CACHE_LINE) std::atomic<Ring *> _ring{nullptr};
+        std::vector<std::unique_ptr<Ring>> _rings;
+};
+
+struct r::core::ThreadPool::Worker {
+        Deque deque;
+        std::thread thread;
+};
+
 /**
 * public
 */
 
-r::core::ThreadPool::ThreadPool(const size_t num_threads) : _stop(false)
+r::core::ThreadPool::ThreadPool(const size_t num_threads) : _injector(std::make_unique<Deque>())
 {
+    /* every deque exists before the first worker starts stealing */
     for (size_t i = 0; i < num_threads; ++i) {
-        _workers.emplace_back([this] { _arbeit(); });
+        _workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        _workers[i]->thread = std::thread([this, i] { _arbeit(i); });
     }
 }
 
 r::core::ThreadPool::~ThreadPool()
 {
-    {
-        std::unique_lock<std::mutex> lock(_queue_mutex);
-        _stop = true;
+    _stop.store(true, std::memory_order_seq_cst);
+    _epoch.fetch_add(1, std::memory_order_release);
+    _epoch.notify_all();
+    for (const auto &worker : _workers) {
+        worker->thread.join();
+    }
+
+    /* workers only leave once every deque looked empty, this only catches tasks submitted while stopping */
+    bool contended = false;
+    while (detail::Task *task = _injector->steal(contended)) {
+        run_task(task);
+    }
+}
+
+void r::core::ThreadPool::parallel_for(const size_t count, const std::function<void(size_t)> &func)
+{
+    if (count == 0) {
+        return;
+    }
+
+    /* shared with the helper tasks, which may only start running after this call returned */
+    struct ParallelFor {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            size_t count = 0;
+            const std::function<void(size_t)> *func = nullptr;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+    };
+
+    const auto job = std::make_shared<ParallelFor>();
+    job->count = count;
+    job->func = &func;
+
+    const auto work = [](ParallelFor &pf) {
+        for (size_t i = pf.next.fetch_add(1, std::memory_order_relaxed); i < pf.count; i = pf.next.fetch_add(1, std::memory_order_relaxed)) {
+            try {
+                (*pf.func)(i);
+            } catch (...) {
+                std::scoped_lock lock(pf.error_mutex);
+                if (!pf.error) {
+                    pf.error = std::current_exception();
+                }
+            }
+            if (pf.done.fetch_add(1, std::memory_order_acq_rel) + 1 == pf.count) {
+                pf.done.notify_all();
+            }
+        }
+    };
+
+    const size_t helpers = _stop.load(std::memory_order_acquire) ? 0 : std::min(_workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        auto helper = [job, work] { work(*job); };
+
+        /* nobody waits on the helpers, the pool holds the only reference */
+        _submit(new detail::TaskOf<decltype(helper), void>(std::move(helper)));
     }
-    _condition.notify_all();
-    for (std::thread &worker : _workers) {
-        worker.join();
+
+    work(*job);
+    for (size_t done = job->done.load(std::memory_order_acquire); done < count; done = job->done.load(std::memory_order_acquire)) {
+        job->done.wait(done, std::memory_order_acquire);
+    }
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
     }
 }
 
+size_t r::core::ThreadPool::size() const noexcept
+{
+    return _workers.size();
+}
+
 /**
 * private
 */
 
-void r::core::ThreadPool::_arbeit()
+void r::core::ThreadPool::_submit(detail::Task *task)
+{
+    if (_workers.empty()) {
+        run_task(task);
+        return;
+    }
+    if (tl_pool == this) {
+        _workers[tl_worker]->deque.push(task);
+    } else {
+        const std::scoped_lock lock(_injector_mutex);
+        _injector->push(task);
+    }
+    _wake_one();
+}
+
+void r::core::ThreadPool::_wait(const detail::Task &task)
 {
+    const bool is_worker = tl_pool == this;
+    u32 spins = 0;
+
+    while (task.done.load(std::memory_order_acquire) == 0) {
+        if (is_worker) {
+            /* help instead of blocking, the awaited task may be sitting in our own deque */
+            bool contended = false;
+
+            if (detail::Task *other = _find_work(tl_worker, contended)) {
+                run_task(other);
+                continue;
+            }
+            if (contended) {
+                continue;
+            }
+        } else if (spins++ < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+        task.done.wait(0, std::memory_order_acquire);
+    }
+}
+
+r::core::detail::Task *r::core::ThreadPool::_find_work(const size_t self, bool &contended)
+{
+    const size_t count = _workers.size();
+
+    if (self < count) {
+        if (detail::Task *task = _workers[self]->deque.pop()) {
+            return task;
+        }
+    }
+    if (detail::Task *task = _injector->steal(contended)) {
+        return task;
+    }
+    for (size_t i = 1; i <= count; ++i) {
+        const size_t victim = (self + i) % count;
+
+        if (victim == self) {
+            continue;
+        }
+        if (detail::Task *task = _workers[victim]->deque.steal(contended)) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void r::core::ThreadPool::_wake_one() noexcept
+{
+    /* pairs with the fence of a parking worker: either it sees the new task, or we see it sleeping */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load(std::memory_order_relaxed) > 0) {
+        _epoch.fetch_add(1, std::memory_order_release);
+        _epoch.notify_one();
+    }
+}
+
+void r::core::ThreadPool::_arbeit(const size_t index)
+{
+    tl_pool = this;
+    tl_worker = index;
+
     for (;;) {
-        std::function<void()> task;
-        {
-            std::unique_lock<std::mutex> lock(this->_queue_mutex);
-            this->_condition.wait(lock, [this] { return this->_stop || !this->_tasks.empty(); });
-            if (this->_stop && this->_tasks.empty()) {
+        detail::Task *task = nullptr;
+        bool contended = false;
+
+        for (u32 round = 0; !task && round < SPIN_ROUNDS; ++round) {
+            contended = false;
+            task = _find_work(index, contended);
+            if (!task && !contended) {
+                std::this_thread::yield();
+            }
+        }
+        if (task) {
+            run_task(task);
+            continue;
+        }
+
+        /* park, re-checking the deques after announcing it so a concurrent submit cannot be missed */
+        const u32 epoch = _epoch.load(std::memory_order_acquire);
+
+        _sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        contended = false;
+        task = _find_work(index, contended);
+        if (!task && !contended) {
+            if (_stop.load(std::memory_order_acquire)) {
+                _sleepers.fetch_sub(1, std::memory_order_relaxed);
                 return;
             }
-            task = std::move(this->_tasks.front());
-            this->_tasks.pop();
+            _epoch.wait(epoch, std::memory_order_acquire);
+        }
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if (task) {
+            run_task(task);
         }
-        task();
     }
 }
@@ -1,5 +1,15 @@
+#include <R-Engine/Core/Error.hpp>
 #include <R-Engine/ECS/Command.hpp>
 
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * @brief Shortest run of same-bundle spawns applied with Scene::spawn_batch_reserved.
+ * @details Shorter runs are spawned one by one, gathering them into vectors costs more than it saves.
+ */
+static constexpr usize MIN_SPAWN_BATCH = 16;
+
 /**
 * public
 */
@@ -19,59 +29,118 @@ r::ecs::Entity r::ecs::EntityCommands::id() const noexcept
 }
 
 /**
- * CommandBuffer
+ * CommandArena
  */
 
-void r::ecs::CommandBuffer::apply(Scene &scene)
+r::ecs::CommandArena::~CommandArena()
 {
-    scene.clear_command_buffer_placeholder_map();
-    for (const auto &command : _commands) {
-        command(scene);
+    for (const Block &block : _blocks) {
+        delete[] block.data;
     }
-    _commands.clear();
 }
 
-void r::ecs::CommandBuffer::despawn(Entity e)
+void *r::ecs::CommandArena::allocate(usize size, usize alignment)
 {
-    _add_command([e](Scene &scene) {
-        const auto &map = scene.get_command_buffer_placeholder_map();
-        const auto it = map.find(e);
-        const Entity real_entity = (it != map.end()) ? it->second : e;
+    while (_block < _blocks.size()) {
+        const Block &block = _blocks[_block];
+        const auto base = reinterpret_cast<std::uintptr_t>(block.data);
+        const usize aligned = ((base + _offset + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1)) - base;
+
+        if (aligned + size <= block.size) {
+            _offset = aligned + size;
+            return block.data + aligned;
+        }
+        ++_block;
+        _offset = 0;
+    }
+    /* worst case padding is alignment - 1 bytes, oversized payloads get a block of their own */
+    const usize block_size = (std::max)(BLOCK_SIZE, size + alignment);
 
-        scene.destroy_entity(real_entity);
-    });
+    _blocks.push_back({new std::byte[block_size], block_size});
+    _block = _blocks.size() - 1;
+    return allocate(size, alignment);
 }
 
-r::ecs::Entity r::ecs::CommandBuffer::spawn_entity()
+void r::ecs::CommandArena::reset() noexcept
 {
-    const Entity placeholder = _next_placeholder--;
+    _block = 0;
+    _offset = 0;
+}
 
-    _add_command([placeholder](Scene &scene) {
-        const Entity real_entity = scene.create_entity();
+/**
+ * CommandBuffer
+ */
 
-        scene.map_command_buffer_placeholder(placeholder, real_entity);
-    });
+r::ecs::CommandBuffer::CommandBuffer(Scene *scene) noexcept : _scene(scene)
+{
+    /* __ctor__ */
+}
 
-    return placeholder;
+r::ecs::CommandBuffer::~CommandBuffer()
+{
+    _drop_pending();
+    delete _commands_wrapper;
 }
 
-void r::ecs::CommandBuffer::add_child(Entity parent, Entity child)
+void r::ecs::CommandBuffer::apply(Scene &scene)
 {
-    _add_command([parent, child](Scene &scene) {
-        const auto &map = scene.get_command_buffer_placeholder_map();
-        const auto parent_it = map.find(parent);
-        const auto child_it = map.find(child);
-        const Entity real_parent = (parent_it != map.end()) ? parent_it->second : parent;
-        const Entity real_child = (child_it != map.end()) ? child_it->second : child;
+    _merged.clear();
+    for (CommandRecord *record = _head; record; record = record->next) {
+        _merged.push_back(record);
+    }
+    _apply_records(scene, _merged);
+    _drop_pending();
+}
 
-        if (scene.has_component<Children>(real_parent)) {
-            auto children = scene.get_component_ptr<Children>(real_parent);
+void r::ecs::CommandBuffer::apply_merged(Scene &scene, CommandBuffer &main, const std::vector<std::unique_ptr<CommandBuffer>> &others)
+{
+    auto &records = main._merged;
 
-            children->entities.push_back(real_child);
-        } else {
-            scene.add_component(real_parent, Children{{real_child}});
+    records.clear();
+    for (CommandRecord *record = main._head; record; record = record->next) {
+        records.push_back(record);
+    }
+    for (const auto &buffer : others) {
+        for (CommandRecord *record = buffer->_head; record; record = record->next) {
+            records.push_back(record);
         }
-    });
+    }
+    /* a source only ever writes to one buffer, so the stable sort keeps its recording order */
+    std::stable_sort(records.begin(), records.end(), [](const CommandRecord *a, const CommandRecord *b) { return a->source < b->source; });
+    _apply_records(scene, records);
+
+    main._drop_pending();
+    for (const auto &buffer : others) {
+        buffer->_drop_pending();
+    }
+}
+
+void r::ecs::CommandBuffer::set_source(u64 source) noexcept
+{
+    _source = source;
+}
+
+u64 r::ecs::CommandBuffer::get_source() const noexcept
+{
+    return _source;
+}
+
+void r::ecs::CommandBuffer::despawn(Entity e)
+{
+    _push(CommandOp::Despawn, e);
+}
+
+r::ecs::Entity r::ecs::CommandBuffer::spawn_entity()
+{
+    const Entity e = _reserve_entity();
+
+    _push(CommandOp::Spawn, e);
+    return e;
+}
+
+void r::ecs::CommandBuffer::add_child(Entity parent, Entity child)
+{
+    _push(CommandOp::AddChild, parent, child);
 }
 
 r::ecs::Commands *r::ecs::CommandBuffer::get_commands() noexcept
@@ -82,9 +151,89 @@ r::ecs::Commands *r::ecs::CommandBuffer::get_commands() noexcept
     return _commands_wrapper;
 }
 
-void r::ecs::CommandBuffer::_add_command(std::function<void(Scene &)> &&command)
+/**
+* private
+*/
+
+r::ecs::Entity r::ecs::CommandBuffer::_reserve_entity()
 {
-    _commands.emplace_back(std::move(command));
+    if (!_scene) {
+        throw exception::Error("r::ecs::CommandBuffer", "cannot spawn entities, the buffer is not bound to a scene");
+    }
+    return _scene->reserve_entity();
+}
+
+r::ecs::CommandRecord &r::ecs::CommandBuffer::_push(CommandOp op, Entity entity, Entity target)
+{
+    auto *record = ::new (_arena.allocate(sizeof(CommandRecord), alignof(CommandRecord)))
+        CommandRecord{nullptr, nullptr, nullptr, nullptr, nullptr, _source, entity, target, op};
+
+    if (_tail) {
+        _tail->next = record;
+    } else {
+        _head = record;
+    }
+    _tail = record;
+    return *record;
+}
+
+void r::ecs::CommandBuffer::_apply_records(Scene &scene, std::vector<CommandRecord *> &records)
+{
+    /* structural changes are stamped with a tick newer than every system run so far */
+    scene.increment_change_tick();
+    for (usize i = 0; i < records.size();) {
+        CommandRecord &record = *records[i];
+        usize run = 1;
+
+        if (record.op == CommandOp::SpawnBundle) {
+            while (i + run < records.size() && records[i + run]->op == CommandOp::SpawnBundle
+                && records[i + run]->apply_batch == record.apply_batch) {
+                ++run;
+            }
+        }
+        if (run >= MIN_SPAWN_BATCH) {
+            record.apply_batch(scene, records.data() + i, run);
+        } else {
+            _apply_record(scene, record);
+            run = 1;
+        }
+        i += run;
+    }
+    records.clear();
+}
+
+void r::ecs::CommandBuffer::_apply_record(Scene &scene, CommandRecord &record)
+{
+    switch (record.op) {
+        case CommandOp::Spawn:
+            scene.spawn_reserved(record.entity);
+            break;
+        case CommandOp::Despawn:
+            scene.destroy_entity(record.entity);
+            break;
+        case CommandOp::AddChild:
+            scene.add_child(record.entity, record.target);
+            break;
+        case CommandOp::SpawnBundle:
+        case CommandOp::Insert:
+        case CommandOp::Remove:
+        case CommandOp::Custom:
+        default:
+            record.apply(scene, record);
+            break;
+    }
+}
+
+void r::ecs::CommandBuffer::_drop_pending() noexcept
+{
+    for (CommandRecord *record = _head; record; record = record->next) {
+        if (record->drop) {
+            record->drop(record->payload);
+        }
+    }
+    _head = nullptr;
+    _tail = nullptr;
+    _arena.reset();
 }
 
 /**
@@ -96,11 +245,11 @@ r::ecs::Commands::Commands(CommandBuffer *buffer) noexcept : _buffer(buffer)
     /* __ctor__ */
 }
 
-r::ecs::EntityCommands r::ecs::Commands::spawn() noexcept
+r::ecs::EntityCommands r::ecs::Commands::spawn()
 {
-    const Entity placeholder = _buffer ? _buffer->spawn_entity() : 0;
+    const Entity e = _buffer ? _buffer->spawn_entity() : 0;
 
-    return EntityCommands(_buffer, placeholder);
+    return EntityCommands(_buffer, e);
 }
 
 r::ecs::EntityCommands r::ecs::Commands::entity(Entity e) noexcept
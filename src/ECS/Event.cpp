@@ -0,0 +1,27 @@
+#include <R-Engine/ECS/Event.hpp>
+
+/**
+* public
+*/
+
+usize r::ecs::current_thread_slot() noexcept
+{
+    static std::atomic<usize> next_slot{0};
+    thread_local const usize slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+
+    return slot;
+}
+
+u64 &r::ecs::current_event_batch() noexcept
+{
+    thread_local u64 batch = 0;
+
+    return batch;
+}
+
+u64 r::ecs::next_event_channel() noexcept
+{
+    static std::atomic<u64> next_channel{1};
+
+    return next_channel.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,286 @@
+#include <R-Engine/ECS/Hierarchy.hpp>
+
+#include <algorithm>
+#include <utility>
+
+/**
+* public
+*/
+
+bool r::ecs::HierarchyIndex::link(Entity parent, Entity child)
+{
+    if (parent == child) {
+        return false;
+    }
+    for (const Node *ancestor = _find(parent); ancestor; ancestor = _find(ancestor->parent)) {
+        if (ancestor->parent == child) {
+            return false;
+        }
+    }
+
+    /* _ensure may grow the nodes, so the parent is looked up again once both exist */
+    _ensure(parent);
+    Node &child_node = _ensure(child);
+    Node &parent_node = *_find(parent);
+
+    if (child_node.parent == parent) {
+        return true;
+    }
+
+    /* the subtree of the child goes to the back of the order first, so no other range contains it */
+    if (child_node.parent != NULL_ENTITY) {
+        _detach_to_back(child_node);
+    } else {
+        const usize descendants = _descendants_begin(child_node);
+
+        _order.push_back({child, parent});
+        child_node.order = _order.size() - 1;
+        _move_range(descendants, child_node.size - 1, _order.size());
+    }
+    _move_range(_order.size() - child_node.size, child_node.size, _descendants_begin(parent_node) + parent_node.size - 1);
+
+    child_node.parent = parent;
+    child_node.prev_sibling = parent_node.last_child;
+    if (Node *last = _find(parent_node.last_child)) {
+        last->next_sibling = child;
+    } else {
+        parent_node.first_child = child;
+    }
+    parent_node.last_child = child;
+    _order[child_node.order].parent = parent;
+    _resize_ancestors(child_node, child_node.size);
+    _set_subtree_depth(child_node, parent_node.depth + 1);
+    return true;
+}
+
+void r::ecs::HierarchyIndex::unlink(Entity child) noexcept
+{
+    Node *node = _find(child);
+
+    if (!node || node->parent == NULL_ENTITY) {
+        return;
+    }
+    _detach_to_back(*node);
+    _move_range(node->order, 1, _order.size());
+    _order.pop_back();
+    node->order = INVALID_ORDER;
+    _set_subtree_depth(*node, 0);
+}
+
+void r::ecs::HierarchyIndex::remove(Entity e) noexcept
+{
+    Node *node = _find(e);
+
+    if (!node) {
+        return;
+    }
+    while (node->first_child != NULL_ENTITY) {
+        unlink(node->first_child);
+    }
+    unlink(e);
+    *node = Node{};
+}
+
+void r::ecs::HierarchyIndex::remove_subtree(Entity root) noexcept
+{
+    Node *node = _find(root);
+
+    if (!node) {
+        return;
+    }
+
+    /* the subtree is one range of the order: the root and its descendants, or only the descendants of a root */
+    const bool linked = node->parent != NULL_ENTITY;
+    const usize begin = linked ? node->order : _descendants_begin(*node);
+    const usize count = linked ? node->size : node->size - 1;
+
+    if (linked) {
+        _resize_ancestors(*node, -static_cast<i64>(node->size));
+        _detach(*node);
+    }
+    for (usize i = begin; i < begin + count; ++i) {
+        *_find(_order[i].entity) = Node{};
+    }
+    *node = Node{};
+    _order.erase(_order.begin() + static_cast<std::ptrdiff_t>(begin), _order.begin() + static_cast<std::ptrdiff_t>(begin + count));
+    for (usize i = begin; i < _order.size(); ++i) {
+        _find(_order[i].entity)->order = i;
+    }
+}
+
+bool r::ecs::HierarchyIndex::is_linked(Entity e) const noexcept
+{
+    const Node *node = _find(e);
+
+    return node && (node->parent != NULL_ENTITY || node->first_child != NULL_ENTITY);
+}
+
+r::ecs::Entity r::ecs::HierarchyIndex::parent(Entity e) const noexcept
+{
+    const Node *node = _find(e);
+
+    return node ? node->parent : NULL_ENTITY;
+}
+
+r::ecs::Entity r::ecs::HierarchyIndex::first_child(Entity e) const noexcept
+{
+    const Node *node = _find(e);
+
+    return node ? node->first_child : NULL_ENTITY;
+}
+
+r::ecs::Entity r::ecs::HierarchyIndex::next_sibling(Entity e) const noexcept
+{
+    const Node *node = _find(e);
+
+    return node ? node->next_sibling : NULL_ENTITY;
+}
+
+u32 r::ecs::HierarchyIndex::depth(Entity e) const noexcept
+{
+    const Node *node = _find(e);
+
+    return node ? node->depth : 0;
+}
+
+void r::ecs::HierarchyIndex::collect_descendants(Entity root, std::vector<Entity> &out) const
+{
+    const usize begin = out.size();
+
+    out.push_back(root);
+    for (usize i = begin; i < out.size(); ++i) {
+        for (Entity child = first_child(out[i]); child != NULL_ENTITY; child = next_sibling(child)) {
+            out.push_back(child);
+        }
+    }
+}
+
+const std::vector<r::ecs::HierarchyIndex::Link> &r::ecs::HierarchyIndex::depth_order() const noexcept
+{
+    return _order;
+}
+
+/**
+* private
+*/
+
+r::ecs::HierarchyIndex::Node *r::ecs::HierarchyIndex::_find(Entity e) noexcept
+{
+    const u32 index = entity_index(e);
+
+    return index < _nodes.size() && _nodes[index].self == e ? &_nodes[index] : nullptr;
+}
+
+const r::ecs::HierarchyIndex::Node *r::ecs::HierarchyIndex::_find(Entity e) const noexcept
+{
+    const u32 index = entity_index(e);
+
+    return index < _nodes.size() && _nodes[index].self == e ? &_nodes[index] : nullptr;
+}
+
+r::ecs::HierarchyIndex::Node &r::ecs::HierarchyIndex::_ensure(Entity e)
+{
+    const u32 index = entity_index(e);
+
+    if (index >= _nodes.size()) {
+        _nodes.resize(std::max<usize>(usize{index} + 1, _nodes.size() * 2));
+    }
+
+    Node &node = _nodes[index];
+
+    if (node.self != e) {
+        node = Node{};
+        node.self = e;
+    }
+    return node;
+}
+
+void r::ecs::HierarchyIndex::_detach(Node &node) noexcept
+{
+    Node *parent = _find(node.parent);
+
+    if (!parent) {
+        return;
+    }
+    if (Node *prev = _find(node.prev_sibling)) {
+        prev->next_sibling = node.next_sibling;
+    } else {
+        parent->first_child = node.next_sibling;
+    }
+    if (Node *next = _find(node.next_sibling)) {
+        next->prev_sibling = node.prev_sibling;
+    } else {
+        parent->last_child = node.prev_sibling;
+    }
+    node.parent = NULL_ENTITY;
+    node.prev_sibling = NULL_ENTITY;
+    node.next_sibling = NULL_ENTITY;
+}
+
+void r::ecs::HierarchyIndex::_resize_ancestors(const Node &node, i64 delta) noexcept
+{
+    for (Node *ancestor = _find(node.parent); ancestor; ancestor = _find(ancestor->parent)) {
+        ancestor->size = static_cast<u32>(static_cast<i64>(ancestor->size) + delta);
+    }
+}
+
+void r::ecs::HierarchyIndex::_set_subtree_depth(Node &root, u32 depth) noexcept
+{
+    /* threaded walk through the links, no stack needed */
+    root.depth = depth;
+
+    Node *node = _find(root.first_child);
+
+    while (node && node != &root) {
+        node->depth = _find(node->parent)->depth + 1;
+        if (Node *child = _find(node->first_child)) {
+            node = child;
+            continue;
+        }
+        while (node != &root && node->next_sibling == NULL_ENTITY) {
+            node = _find(node->parent);
+        }
+        if (node != &root) {
+            node = _find(node->next_sibling);
+        }
+    }
+}
+
+usize r::ecs::HierarchyIndex::_descendants_begin(const Node &node) const noexcept
+{
+    if (node.parent != NULL_ENTITY) {
+        return node.order + 1;
+    }
+
+    const Node *first = _find(node.first_child);
+
+    return first ? first->order : _order.size();
+}
+
+void r::ecs::HierarchyIndex::_move_range(usize begin, usize count, usize pos) noexcept
+{
+    /* moves [begin, begin + count) in front of pos, only the entries in between change position */
+    if (count == 0 || pos == begin || pos == begin + count) {
+        return;
+    }
+
+    const auto at = [this](usize i) { return _order.begin() + static_cast<std::ptrdiff_t>(i); };
+    const usize first = pos < begin ? pos : begin;
+    const usize last = pos < begin ? begin + count : pos;
+
+    if (pos < begin) {
+        std::rotate(at(pos), at(begin), at(begin + count));
+    } else {
+        std::rotate(at(begin), at(begin + count), at(pos));
+    }
+    for (usize i = first; i < last; ++i) {
+        _find(_order[i].entity)->order = i;
+    }
+}
+
+void r::ecs::HierarchyIndex::_detach_to_back(Node &node) noexcept
+{
+    _resize_ancestors(node, -static_cast<i64>(node.size));
+    _detach(node);
+    _move_range(node.order, node.size, _order.size());
+}
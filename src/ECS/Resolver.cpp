@@ -5,7 +5,13 @@
 * public
 */
 
-r::ecs::Resolver::Resolver(Scene *s, CommandBuffer *cmd) : _scene(s), _cmd_buffer(cmd)
+r::ecs::Resolver::Resolver(Scene *s, CommandBuffer *cmd) : _scene(s), _cmd_buffer(cmd), _this_run(s->increment_change_tick())
+{
+    /* __ctor__ */
+}
+
+r::ecs::Resolver::Resolver(Scene *s, CommandBuffer *cmd, u32 last_run, u32 this_run)
+    : _scene(s), _cmd_buffer(cmd), _last_run(last_run), _this_run(this_run)
 {
     /* __ctor__ */
 }
@@ -15,7 +21,12 @@ r::ecs::Commands r::ecs::Resolver::resolve(std::type_identity<Commands>)
     return Commands(_cmd_buffer);
 }
 
-r::ecs::Scene &r::ecs::Resolver::resolve(std::type_identity<Scene &>)
+r::ecs::Hierarchy r::ecs::Resolver::resolve(std::type_identity<Hierarchy>)
+{
+    return Hierarchy{&_scene->get_hierarchy()};
+}
+
+r::ecs::Scene &r::ecs::Resolver::resolve(std::type_identity<Scene>)
 {
     return *_scene;
 }
@@ -1,12 +1,40 @@
+#include <R-Engine/Core/Error.hpp>
 #include <R-Engine/ECS/Command.hpp>
 #include <R-Engine/ECS/Scene.hpp>
-#include <deque>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * @brief Number of destroyed entity indices kept aside before they start being reused.
+ * @details Reusing slots oldest first from a large enough pool spreads generation bumps across slots,
+ * so a stale handle stays detectable for a long time even under heavy spawn/despawn churn.
+ */
+static constexpr usize MIN_FREE_ENTITIES = 1024;
+static constexpr usize INVALID_LOCATION = (std::numeric_limits<usize>::max)();
+/** @brief Location of an entity that was reserved and flushed but not spawned yet. */
+static constexpr usize RESERVED_LOCATION = INVALID_LOCATION - 1;
+
+r::ecs::ResourceId r::ecs::register_resource_id(const std::type_index &type)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::type_index, ResourceId> ids;
+
+    const std::scoped_lock lock(mutex);
+    return ids.try_emplace(type, static_cast<ResourceId>(ids.size())).first->second;
+}
 
 r::ecs::Scene::Scene()
 {
     /** Create the initial empty archetype at index 0 */
     _archetypes.emplace_back();
-    _archetype_map[{}] = 0;
+    _archetype_map[ComponentMask{}] = 0;
+    _archetype_generation = 1;
+
+    /** Entity index 0 is reserved, a zero handle never refers to a live entity */
+    _entity_locations.push_back({INVALID_LOCATION, 0});
+    _entity_generations.push_back(0);
 }
 
 const std::vector<r::ecs::Archetype> &r::ecs::Scene::get_archetypes() const
@@ -14,91 +42,406 @@ const std::vector<r::ecs::Archetype> &r::ecs::Scene::get_archetypes() const
     return _archetypes;
 }
 
-const r::ecs::EntityLocation *r::ecs::Scene::get_entity_location(r::ecs::Entity e) const
+u64 r::ecs::Scene::get_archetype_generation() const noexcept
 {
-    const auto it = _entity_locations.find(e);
-    if (it == _entity_locations.end()) {
-        return nullptr;
+    return _archetype_generation;
+}
+
+u64 r::ecs::Scene::get_resource_generation() const noexcept
+{
+    return _resource_generation;
+}
+
+void r::ecs::Scene::update_removed_components() noexcept
+{
+    for (auto &log : _removed_logs) {
+        log.readable.swap(log.pending);
+        log.pending.clear();
     }
-    return &it->second;
+}
+
+u32 r::ecs::Scene::increment_change_tick() noexcept
+{
+    return _change_tick.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+u32 r::ecs::Scene::get_change_tick() const noexcept
+{
+    return _change_tick.load(std::memory_order_relaxed);
+}
+
+void r::ecs::Scene::set_thread_pool(core::ThreadPool *pool) noexcept
+{
+    _thread_pool = pool;
+}
+
+r::core::ThreadPool *r::ecs::Scene::get_thread_pool() const noexcept
+{
+    return _thread_pool;
+}
+
+const r::ecs::SparseSet *r::ecs::Scene::get_sparse_set(ComponentId id) const noexcept
+{
+    return id < _sparse_sets.size() ? _sparse_sets[id].get() : nullptr;
+}
+
+const r::ecs::EntityLocation *r::ecs::Scene::get_entity_location(r::ecs::Entity e) const noexcept
+{
+    return const_cast<Scene *>(this)->_find_location(e);
+}
+
+bool r::ecs::Scene::is_alive(r::ecs::Entity e) const noexcept
+{
+    return get_entity_location(e) != nullptr;
 }
 
 r::ecs::Entity r::ecs::Scene::create_entity()
 {
-    const Entity new_entity = _next_entity++;
+    const Entity new_entity = _allocate_entity();
     Archetype &empty_archetype = _archetypes[0];
     const usize row = empty_archetype.table.add_entity(new_entity);
-    _entity_locations[new_entity] = {0, row};
+    _entity_locations[entity_index(new_entity)] = {0, row};
     return new_entity;
 }
 
 void r::ecs::Scene::destroy_entity(r::ecs::Entity e) noexcept
 {
-    std::deque<r::ecs::Entity> queue;
-    if (_entity_locations.count(e)) {
-        queue.push_back(e);
+    if (!is_alive(e)) {
+        return;
     }
 
-    while (!queue.empty()) {
-        Entity current_entity = queue.front();
-        queue.pop_front();
+    std::vector<Entity> doomed;
+    const Entity parent = _hierarchy.parent(e);
 
-        /* If the entity has children, add them to the queue for destruction. */
-        if (auto *children_comp = get_component_ptr<Children>(current_entity)) {
-            for (Entity child : children_comp->entities) {
-                if (_entity_locations.count(child)) {
-                    queue.push_back(child);
-                }
-            }
-        }
+    _hierarchy.collect_descendants(e, doomed);
+    if (auto *siblings = parent != NULL_ENTITY ? get_component_ptr<Children>(parent) : nullptr) {
+        std::erase(siblings->entities, e);
+    }
+    _hierarchy.remove_subtree(e);
 
-        /* Proceed with destroying the current entity. */
-        const auto it = _entity_locations.find(current_entity);
-        if (it == _entity_locations.end()) {
+    for (const Entity current_entity : doomed) {
+        const EntityLocation *loc_ptr = _find_location(current_entity);
+        if (!loc_ptr) {
             continue;
         }
 
-        const EntityLocation loc = it->second;
+        const EntityLocation loc = *loc_ptr;
         Archetype &archetype = _archetypes[loc.archetype_index];
 
+        _record_removals(archetype, current_entity);
+        for (const auto &set : _sparse_sets) {
+            if (set && set->remove(current_entity) && _tracked_removals.test(set->column().info()->id)) {
+                _removed_logs[set->column().info()->id].pending.push_back(current_entity);
+            }
+        }
+
         Entity swapped_entity = archetype.table.remove_entity_swap_back(loc.table_row);
 
-        _entity_locations.erase(current_entity);
+        /* Bump the generation so that every handle to the destroyed entity becomes stale. */
+        const u32 index = entity_index(current_entity);
+        u32 &generation = _entity_generations[index];
+        generation = generation >= MAX_ENTITY_GENERATION ? 0 : generation + 1;
+        _entity_locations[index] = {INVALID_LOCATION, 0};
+        _free_entities.push_back(index);
+
         if (swapped_entity != 0) {
-            _entity_locations[swapped_entity].table_row = loc.table_row;
+            _entity_locations[entity_index(swapped_entity)].table_row = loc.table_row;
         }
     }
+    /* make the freed indices reservable */
+    flush_reserved_entities();
 }
 
-void r::ecs::Scene::clear_command_buffer_placeholder_map() noexcept
+void r::ecs::Scene::_despawn_matching(const EntityFilter &filter)
 {
-    _placeholder_map.clear();
+    const bool row_filtered = filter.sparse_required.any() || filter.sparse_excluded.any();
+    const auto matches = [&filter](const Archetype &archetype) {
+        return !archetype.table.entities.empty() && (archetype.mask & filter.required) == filter.required
+            && (archetype.mask & filter.excluded).none();
+    };
+    std::vector<Entity> one_by_one;
+
+    /* entities in a hierarchy take their subtree with them and must leave their parent's Children */
+    for (const Archetype &archetype : _archetypes) {
+        if (!matches(archetype)) {
+            continue;
+        }
+        for (const Entity e : archetype.table.entities) {
+            if (row_filtered ? _sparse_matches(e, filter) : _hierarchy.is_linked(e)) {
+                one_by_one.push_back(e);
+            }
+        }
+    }
+    for (const Entity e : one_by_one) {
+        destroy_entity(e);
+    }
+    if (row_filtered) {
+        return;
+    }
+
+    for (Archetype &archetype : _archetypes) {
+        if (!matches(archetype)) {
+            continue;
+        }
+
+        const std::vector<Entity> &entities = archetype.table.entities;
+
+        if ((archetype.mask & _tracked_removals).any()) {
+            for (const ComponentId id : archetype.component_ids) {
+                if (_tracked_removals.test(id)) {
+                    _removed_logs[id].pending.insert(_removed_logs[id].pending.end(), entities.begin(), entities.end());
+                }
+            }
+        }
+        for (const auto &set : _sparse_sets) {
+            if (!set || set->entities().empty()) {
+                continue;
+            }
+            for (const Entity e : entities) {
+                if (set->remove(e) && _tracked_removals.test(set->column().info()->id)) {
+                    _removed_logs[set->column().info()->id].pending.push_back(e);
+                }
+            }
+        }
+        for (const Entity e : entities) {
+            const u32 index = entity_index(e);
+            u32 &generation = _entity_generations[index];
+
+            generation = generation >= MAX_ENTITY_GENERATION ? 0 : generation + 1;
+            _entity_locations[index] = {INVALID_LOCATION, 0};
+            _free_entities.push_back(index);
+        }
+        archetype.table.clear();
+    }
+    flush_reserved_entities();
 }
 
-void r::ecs::Scene::map_command_buffer_placeholder(Entity placeholder, Entity real) noexcept
+bool r::ecs::Scene::_sparse_matches(Entity e, const EntityFilter &filter) const noexcept
 {
-    _placeholder_map[placeholder] = real;
+    for (usize id = 0; id < _sparse_sets.size(); ++id) {
+        const bool present = _sparse_sets[id] && _sparse_sets[id]->contains(e);
+
+        if ((filter.sparse_required.test(id) && !present) || (filter.sparse_excluded.test(id) && present)) {
+            return false;
+        }
+    }
+    /* a required sparse component that was never inserted has no set at all */
+    for (usize id = _sparse_sets.size(); id < MAX_COMPONENTS; ++id) {
+        if (filter.sparse_required.test(id)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-const std::unordered_map<r::ecs::Entity, r::ecs::Entity> &r::ecs::Scene::get_command_buffer_placeholder_map() const noexcept
+void r::ecs::Scene::add_child(Entity parent, Entity child)
 {
-    return _placeholder_map;
+    if (!is_alive(parent) || !is_alive(child)) {
+        return;
+    }
+
+    const Entity old_parent = _hierarchy.parent(child);
+
+    if (old_parent == parent || !_hierarchy.link(parent, child)) {
+        return;
+    }
+    if (auto *old_siblings = old_parent != NULL_ENTITY ? get_component_ptr<Children>(old_parent) : nullptr) {
+        std::erase(old_siblings->entities, child);
+    }
+    if (auto *children = get_component_ptr<Children>(parent)) {
+        children->entities.push_back(child);
+    } else {
+        _insert_component(parent, Children{{child}});
+    }
+    _insert_component(child, Parent{parent});
 }
 
-usize r::ecs::Scene::_find_or_create_archetype(const std::vector<std::type_index> &types)
+void r::ecs::Scene::_set_children(Entity parent, std::vector<Entity> children)
 {
-    const auto arch_it = _archetype_map.find(types);
+    if (!is_alive(parent)) {
+        return;
+    }
+    for (Entity child = _hierarchy.first_child(parent); child != NULL_ENTITY;) {
+        const Entity next = _hierarchy.next_sibling(child);
+
+        if (std::find(children.begin(), children.end(), child) == children.end()) {
+            _unparent(child);
+        }
+        child = next;
+    }
+    for (const Entity child : children) {
+        add_child(parent, child);
+    }
+    /* dead children and the ones refused to avoid a cycle are dropped, the requested order is kept */
+    std::erase_if(children, [this, parent](Entity child) { return _hierarchy.parent(child) != parent; });
+    _insert_component(parent, Children{std::move(children)});
+}
+
+void r::ecs::Scene::_unparent(Entity child)
+{
+    const Entity parent = _hierarchy.parent(child);
+
+    if (parent != NULL_ENTITY) {
+        _hierarchy.unlink(child);
+        if (auto *siblings = get_component_ptr<Children>(parent)) {
+            std::erase(siblings->entities, child);
+        }
+    }
+    _erase_component<Parent>(child);
+}
+
+void r::ecs::Scene::_clear_children(Entity parent)
+{
+    for (Entity child = _hierarchy.first_child(parent); child != NULL_ENTITY;) {
+        const Entity next = _hierarchy.next_sibling(child);
+
+        _hierarchy.unlink(child);
+        _erase_component<Parent>(child);
+        child = next;
+    }
+    _erase_component<Children>(parent);
+}
+
+void r::ecs::Scene::_link_spawned_parent(Entity e)
+{
+    const Entity parent = get_component_ptr<Parent>(e)->entity;
+
+    add_child(parent, e);
+    if (_hierarchy.parent(e) != parent) {
+        _erase_component<Parent>(e);
+    }
+}
+
+void r::ecs::Scene::_link_spawned_children(Entity e)
+{
+    _set_children(e, get_component_ptr<Children>(e)->entities);
+}
+
+const r::ecs::HierarchyIndex &r::ecs::Scene::get_hierarchy() const noexcept
+{
+    return _hierarchy;
+}
+
+r::ecs::Entity r::ecs::Scene::reserve_entity()
+{
+    /* positive: the n-th reservable free index from the head is left, otherwise -n new indices were handed out */
+    const i64 n = _reserve_cursor.fetch_sub(1, std::memory_order_relaxed);
+
+    if (n > 0) {
+        const u32 index = _free_entities[_free_head + _reservable_free - static_cast<usize>(n)];
+
+        return make_entity(index, _entity_generations[index]);
+    }
+
+    const usize index = _entity_locations.size() + static_cast<usize>(-n);
+
+    if (index > ENTITY_INDEX_MASK) {
+        /* give the index back, otherwise the next flush would create it */
+        _reserve_cursor.fetch_add(1, std::memory_order_relaxed);
+        throw exception::Error("r::ecs::Scene", "too many live entities (max ", ENTITY_INDEX_MASK, ")");
+    }
+    return make_entity(static_cast<u32>(index), 0);
+}
+
+void r::ecs::Scene::flush_reserved_entities()
+{
+    const i64 cursor = _reserve_cursor.load(std::memory_order_relaxed);
+    const usize reused = cursor >= 0 ? _reservable_free - static_cast<usize>(cursor) : _reservable_free;
+
+    for (usize i = 0; i < reused; ++i) {
+        _entity_locations[_free_entities[_free_head + i]] = {RESERVED_LOCATION, 0};
+    }
+    _free_head += reused;
+    if (cursor < 0) {
+        const usize created = static_cast<usize>(-cursor);
+
+        _entity_locations.resize(_entity_locations.size() + created, {RESERVED_LOCATION, 0});
+        _entity_generations.resize(_entity_generations.size() + created, 0);
+    }
+
+    /* drop the consumed head once it outweighs the live part of the free list */
+    if (_free_head >= MIN_FREE_ENTITIES && _free_head * 2 >= _free_entities.size()) {
+        _free_entities.erase(_free_entities.begin(), _free_entities.begin() + static_cast<std::ptrdiff_t>(_free_head));
+        _free_head = 0;
+    }
+
+    const usize free_count = _free_entities.size() - _free_head;
+
+    _reservable_free = free_count > MIN_FREE_ENTITIES ? free_count - MIN_FREE_ENTITIES : 0;
+    _reserve_cursor.store(static_cast<i64>(_reservable_free), std::memory_order_relaxed);
+}
+
+r::ecs::Entity r::ecs::Scene::_allocate_entity()
+{
+    const Entity e = reserve_entity();
+
+    flush_reserved_entities();
+    return e;
+}
+
+void r::ecs::Scene::_claim_reserved(Entity e)
+{
+    flush_reserved_entities();
+
+    const u32 index = entity_index(e);
+
+    if (index == 0 || index >= _entity_locations.size() || _entity_generations[index] != entity_generation(e)
+        || _entity_locations[index].archetype_index != RESERVED_LOCATION) {
+        throw exception::Error("r::ecs::Scene", "entity ", e, " was not reserved or is already spawned");
+    }
+}
+
+void r::ecs::Scene::_record_removals(const Archetype &archetype, Entity e)
+{
+    if ((archetype.mask & _tracked_removals).none()) {
+        return;
+    }
+    for (const ComponentId id : archetype.component_ids) {
+        if (_tracked_removals.test(id)) {
+            _removed_logs[id].pending.push_back(e);
+        }
+    }
+}
+
+r::ecs::EntityLocation *r::ecs::Scene::_find_location(Entity e) noexcept
+{
+    const u32 index = entity_index(e);
+
+    if (index == 0 || index >= _entity_locations.size() || _entity_generations[index] != entity_generation(e)) {
+        return nullptr;
+    }
+
+    EntityLocation &loc = _entity_locations[index];
+    return loc.archetype_index >= RESERVED_LOCATION ? nullptr : &loc;
+}
+
+usize r::ecs::Scene::_find_or_create_archetype(std::vector<const ComponentInfo *> infos)
+{
+    ComponentMask mask;
+    for (const auto *info : infos) {
+        mask.set(info->id);
+    }
+
+    const auto arch_it = _archetype_map.find(mask);
     if (arch_it != _archetype_map.end()) {
         return arch_it->second;
     }
 
+    std::sort(infos.begin(), infos.end(), [](const ComponentInfo *a, const ComponentInfo *b) { return a->id < b->id; });
+
     const usize new_archetype_idx = _archetypes.size();
     auto &new_arch = _archetypes.emplace_back();
-    new_arch.component_types = types;
-    for (usize i = 0; i < types.size(); ++i) {
-        new_arch.component_map[types[i]] = i;
+    new_arch.mask = mask;
+    new_arch.component_map.assign(infos.empty() ? 0 : infos.back()->id + 1, INVALID_INDEX);
+    new_arch.component_ids.reserve(infos.size());
+    new_arch.table.columns.reserve(infos.size());
+    for (usize i = 0; i < infos.size(); ++i) {
+        new_arch.component_ids.push_back(infos[i]->id);
+        new_arch.component_map[infos[i]->id] = static_cast<u32>(i);
+        new_arch.table.columns.emplace_back(infos[i]);
     }
-    _archetype_map[types] = new_archetype_idx;
+    _archetype_map[mask] = new_archetype_idx;
+    ++_archetype_generation;
     return new_archetype_idx;
 }
 
@@ -113,19 +456,13 @@ void r::ecs::Scene::_move_entity_between_archetypes(Entity e, EntityLocation &lo
 
     /** --- Move The Entity and its Common Components --- */
     const usize new_row = new_table.add_entity(e);
-    if (new_table.columns.empty() && !new_archetype.component_types.empty()) {
-        new_table.columns.resize(new_archetype.component_types.size());
-    }
 
     /* Iterate over the destination archetype's components and pull them from the source. */
-    for (const auto &[type_idx, new_col_idx] : new_archetype.component_map) {
-        auto old_it = old_archetype.component_map.find(type_idx);
-        if (old_it != old_archetype.component_map.end()) {
-            const usize old_col_idx = old_it->second;
-            if (!new_table.columns[new_col_idx]) {
-                new_table.columns[new_col_idx] = old_table.columns[old_col_idx]->clone_empty();
-            }
-            old_table.columns[old_col_idx]->move_to(loc.table_row, *new_table.columns[new_col_idx]);
+    for (usize new_col_idx = 0; new_col_idx < new_archetype.component_ids.size(); ++new_col_idx) {
+        const u32 old_col_idx = old_archetype.column_index(new_archetype.component_ids[new_col_idx]);
+
+        if (old_col_idx != INVALID_INDEX) {
+            old_table.columns[old_col_idx].move_to(old_row, new_table.columns[new_col_idx]);
         }
     }
 
@@ -136,6 +473,6 @@ void r::ecs::Scene::_move_entity_between_archetypes(Entity e, EntityLocation &lo
     loc.archetype_index = new_archetype_idx;
     loc.table_row = new_row;
     if (swapped_entity != 0) {
-        _entity_locations.at(swapped_entity).table_row = old_row;
+        _entity_locations[entity_index(swapped_entity)].table_row = old_row;
     }
 }
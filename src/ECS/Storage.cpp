@@ -1,7 +1,270 @@
+#include <R-Engine/Core/Error.hpp>
 #include <R-Engine/ECS/Storage.hpp>
 
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
 namespace r::ecs {
 
+/** --- Component IDs --- */
+
+ComponentId register_component_id(const std::type_index &type)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::type_index, ComponentId> ids;
+
+    const std::scoped_lock lock(mutex);
+    const auto it = ids.find(type);
+
+    if (it != ids.end()) {
+        return it->second;
+    }
+    if (ids.size() >= MAX_COMPONENTS) {
+        throw exception::Error("r::ecs", "too many component types registered (max ", MAX_COMPONENTS, "), cannot register ", type.name());
+    }
+
+    const auto id = static_cast<ComponentId>(ids.size());
+    ids.emplace(type, id);
+    return id;
+}
+
+/** --- Column --- */
+
+Column::Column(const ComponentInfo *info) noexcept : _info(info)
+{
+    /* __ctor__ */
+}
+
+Column::~Column()
+{
+    _release();
+}
+
+Column::Column(Column &&other) noexcept
+    : _info(other._info), _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)),
+      _capacity(std::exchange(other._capacity, 0)), _added_ticks(std::move(other._added_ticks)),
+      _changed_ticks(std::move(other._changed_ticks))
+{
+    /* __ctor__ */
+}
+
+Column &Column::operator=(Column &&other) noexcept
+{
+    if (this != &other) {
+        _release();
+        _info = other._info;
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _capacity = std::exchange(other._capacity, 0);
+        _added_ticks = std::move(other._added_ticks);
+        _changed_ticks = std::move(other._changed_ticks);
+    }
+    return *this;
+}
+
+void Column::push_move(void *component, u32 tick)
+{
+    if (_size == _capacity) {
+        _grow(_size + 1);
+    }
+
+    void *dst = _data + _size * _info->size;
+
+    if (_info->trivially_relocatable) {
+        std::memcpy(dst, component, _info->size);
+    } else {
+        _info->move_construct(dst, component);
+    }
+    _added_ticks.push_back(tick);
+    _changed_ticks.push_back(tick);
+    ++_size;
+}
+
+void Column::reserve(usize capacity)
+{
+    if (capacity > _capacity) {
+        _grow(capacity);
+    }
+    /* follow the geometric growth of the data, reserving exactly would make repeated small reserves quadratic */
+    _added_ticks.reserve(_capacity);
+    _changed_ticks.reserve(_capacity);
+}
+
+void Column::remove_swap_back(usize index)
+{
+    const usize last = _size - 1;
+    void *slot = _data + index * _info->size;
+
+    if (_info->trivially_relocatable) {
+        if (index < last) {
+            std::memcpy(slot, _data + last * _info->size, _info->size);
+        }
+    } else {
+        _info->destroy(slot);
+        if (index < last) {
+            void *back = _data + last * _info->size;
+
+            _info->move_construct(slot, back);
+            _info->destroy(back);
+        }
+    }
+    _added_ticks[index] = _added_ticks[last];
+    _changed_ticks[index] = _changed_ticks[last];
+    _added_ticks.pop_back();
+    _changed_ticks.pop_back();
+    --_size;
+}
+
+void Column::clear() noexcept
+{
+    if (!_info->trivially_relocatable) {
+        for (usize i = 0; i < _size; ++i) {
+            _info->destroy(_data + i * _info->size);
+        }
+    }
+    _size = 0;
+    _added_ticks.clear();
+    _changed_ticks.clear();
+}
+
+void *Column::get_ptr(usize index) const noexcept
+{
+    return _data + index * _info->size;
+}
+
+void Column::move_to(usize index, Column &dest)
+{
+    dest.push_move(_data + index * _info->size, _changed_ticks[index]);
+    dest._added_ticks.back() = _added_ticks[index];
+}
+
+u32 *Column::added_ticks() const noexcept
+{
+    return const_cast<u32 *>(_added_ticks.data());
+}
+
+u32 *Column::changed_ticks() const noexcept
+{
+    return const_cast<u32 *>(_changed_ticks.data());
+}
+
+usize Column::size() const noexcept
+{
+    return _size;
+}
+
+const ComponentInfo *Column::info() const noexcept
+{
+    return _info;
+}
+
+void Column::_grow(usize min_capacity)
+{
+    const usize new_capacity = (std::max)(min_capacity, _capacity ? _capacity * 2 : usize{8});
+    auto *new_data = static_cast<u8 *>(::operator new(new_capacity * _info->size, std::align_val_t{_info->alignment}));
+
+    if (_data) {
+        if (_info->trivially_relocatable) {
+            std::memcpy(new_data, _data, _size * _info->size);
+        } else {
+            for (usize i = 0; i < _size; ++i) {
+                void *src = _data + i * _info->size;
+
+                _info->move_construct(new_data + i * _info->size, src);
+                _info->destroy(src);
+            }
+        }
+        ::operator delete(_data, std::align_val_t{_info->alignment});
+    }
+    _data = new_data;
+    _capacity = new_capacity;
+}
+
+void Column::_release() noexcept
+{
+    if (!_data) {
+        return;
+    }
+    if (!_info->trivially_relocatable) {
+        for (usize i = 0; i < _size; ++i) {
+            _info->destroy(_data + i * _info->size);
+        }
+    }
+    ::operator delete(_data, std::align_val_t{_info->alignment});
+    _data = nullptr;
+    _size = 0;
+    _capacity = 0;
+    _added_ticks.clear();
+    _changed_ticks.clear();
+}
+
+/** --- SparseSet --- */
+
+SparseSet::SparseSet(const ComponentInfo *info) noexcept : _dense(info)
+{
+    /* __ctor__ */
+}
+
+u32 SparseSet::dense_index(Entity e) const noexcept
+{
+    const u32 index = entity_index(e);
+
+    if (index >= _sparse.size()) {
+        return INVALID_INDEX;
+    }
+
+    const u32 slot = _sparse[index];
+    return slot != INVALID_INDEX && _entities[slot] == e ? slot : INVALID_INDEX;
+}
+
+bool SparseSet::contains(Entity e) const noexcept
+{
+    return dense_index(e) != INVALID_INDEX;
+}
+
+void SparseSet::insert(Entity e, void *component, u32 tick)
+{
+    const u32 index = entity_index(e);
+
+    if (index >= _sparse.size()) {
+        _sparse.resize(index + 1, INVALID_INDEX);
+    }
+    _sparse[index] = static_cast<u32>(_entities.size());
+    _entities.push_back(e);
+    _dense.push_move(component, tick);
+}
+
+bool SparseSet::remove(Entity e)
+{
+    const u32 slot = dense_index(e);
+
+    if (slot == INVALID_INDEX) {
+        return false;
+    }
+
+    const Entity last = _entities.back();
+
+    _dense.remove_swap_back(slot);
+    _entities[slot] = last;
+    _entities.pop_back();
+    _sparse[entity_index(last)] = slot;
+    _sparse[entity_index(e)] = INVALID_INDEX;
+    return true;
+}
+
+const Column &SparseSet::column() const noexcept
+{
+    return _dense;
+}
+
+const std::vector<Entity> &SparseSet::entities() const noexcept
+{
+    return _entities;
+}
+
 /** --- Table --- */
 
 usize Table::add_entity(Entity e)
@@ -22,16 +285,42 @@ Entity Table::remove_entity_swap_back(usize row)
     entities.pop_back();
 
     for (auto &col : columns) {
-        col->remove_swap_back(row);
+        col.remove_swap_back(row);
     }
     return swapped_entity;
 }
 
+void Table::clear() noexcept
+{
+    entities.clear();
+    for (auto &col : columns) {
+        col.clear();
+    }
+}
+
 /** --- Archetype --- */
 
-bool Archetype::has_component(const std::type_index &type) const
+bool Archetype::has_component(ComponentId id) const noexcept
+{
+    return mask.test(id);
+}
+
+u32 Archetype::column_index(ComponentId id) const noexcept
 {
-    return component_map.count(type);
+    return id < component_map.size() ? component_map[id] : INVALID_INDEX;
+}
+
+u32 Archetype::get_edge(const std::vector<u32> &edges, ComponentId id) noexcept
+{
+    return id < edges.size() ? edges[id] : INVALID_INDEX;
+}
+
+void Archetype::set_edge(std::vector<u32> &edges, ComponentId id, usize archetype_idx)
+{
+    if (id >= edges.size()) {
+        edges.resize(id + 1, INVALID_INDEX);
+    }
+    edges[id] = static_cast<u32>(archetype_idx);
 }
 
 }// namespace r::ecs
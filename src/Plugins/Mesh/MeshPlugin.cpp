@@ -1,6 +1,7 @@
 #include <R-Engine/Components/Material3d.hpp>
 #include <R-Engine/Components/Shader.hpp>
 #include <R-Engine/Plugins/MeshPlugin.hpp>
+#include <R-Engine/Plugins/TransformPlugin.hpp>
 
 #include <R-Engine/Application.hpp>
 #include <R-Engine/Maths/Quaternion.hpp>
@@ -56,20 +57,20 @@ static inline const r::Transform3d mesh_plugin_get_transform3d(
 
 static inline ::Shader mesh_plugin_apply_shader(
     ::Model *model,
-    const r::ecs::Optional<r::Material3d> &material_opt,
+    const r::Material3d *material,
     r::ecs::Res<r::Shaders> &shaders
 ) noexcept
 {
     ::Shader original_shader = {};
 
-    if (material_opt.ptr && model && model->materialCount > 0) {
-        const ::Shader *custom_shader = shaders.ptr->get(material_opt.ptr->get_shader());
+    if (material && model && model->materialCount > 0) {
+        const ::Shader *custom_shader = shaders.ptr->get(material->get_shader());
 
         if (custom_shader) {
             original_shader = model->materials[0].shader;
             model->materials[0].shader = *custom_shader;
 
-            mesh_plugin_send_uniforms(*custom_shader, *material_opt.ptr);
+            mesh_plugin_send_uniforms(*custom_shader, *material);
         }
     }
 
@@ -83,6 +84,27 @@ static inline void mesh_plugin_restore_shader(::Model *model, const ::Shader &or
     }
 }
 
+static inline void mesh_plugin_draw(
+    r::Meshes &meshes,
+    const r::MeshHandle id,
+    const r::Transform3d &transform,
+    const r::Color color,
+    const r::Material3d *material,
+    r::ecs::Res<r::Shaders> &shaders
+) noexcept
+{
+    auto *model = meshes.get(id);
+
+    if (!model) {
+        return;
+    }
+
+    const auto &original_shader = mesh_plugin_apply_shader(model, material, shaders);
+
+    meshes.draw(id, transform.position, transform.rotation, transform.scale, color);
+    mesh_plugin_restore_shader(model, original_shader);
+}
+
 /**
  * System
  */
@@ -103,18 +125,44 @@ static void mesh_render_system(
 {
     for (const auto &[mesh_comp, transform, material_opt] : query) {
         const r::Transform3d final_transform = mesh_plugin_get_transform3d(*transform.ptr, *mesh_comp.ptr);
-        auto *model = meshes.ptr->get(mesh_comp.ptr->id);
 
-        if (!model) {
-            continue;
-        }
+        mesh_plugin_draw(*meshes.ptr, mesh_comp.ptr->id, final_transform, mesh_comp.ptr->color, material_opt.ptr, shaders);
+    }
+}
 
-        const auto &original_shader = mesh_plugin_apply_shader(model, material_opt, shaders);
+/**
+ * pipelined mode
+ */
 
-        meshes.ptr->draw(mesh_comp.ptr->id, final_transform.position, final_transform.rotation, final_transform.scale,
-            mesh_comp.ptr->color);
+static void mesh_extract_system(
+    MeshRenderQuery query,
+    r::ecs::ResMut<r::MeshSnapshot> snapshot
+) noexcept
+{
+    snapshot.ptr->draws.clear();
+    snapshot.ptr->materials.clear();
+    for (const auto &[mesh_comp, transform, material_opt] : query) {
+        u32 material = r::MeshSnapshot::NO_MATERIAL;
+
+        if (material_opt.ptr) {
+            material = static_cast<u32>(snapshot.ptr->materials.size());
+            snapshot.ptr->materials.push_back(*material_opt.ptr);
+        }
+        snapshot.ptr->draws.push_back({mesh_comp.ptr->id, mesh_comp.ptr->color, mesh_plugin_get_transform3d(*transform.ptr, *mesh_comp.ptr),
+            material});
+    }
+}
 
-        mesh_plugin_restore_shader(model, original_shader);
+static void mesh_render_snapshot_system(
+    r::ecs::Res<r::MeshSnapshot> snapshot,
+    r::ecs::ResMut<r::Meshes> meshes,
+    r::ecs::Res<r::Shaders> shaders
+) noexcept
+{
+    for (const auto &draw : snapshot.ptr->draws) {
+        const r::Material3d *material = draw.material != r::MeshSnapshot::NO_MATERIAL ? &snapshot.ptr->materials[draw.material] : nullptr;
+
+        mesh_plugin_draw(*meshes.ptr, draw.id, draw.transform, draw.color, material, shaders);
     }
 }
 
@@ -138,8 +186,16 @@ void r::MeshPlugin::build(r::Application &app)
 {
     app.insert_resource(Meshes{})
         .insert_resource(Shaders{})
-        .add_systems<process_mesh_creation_system>(Schedule::BEFORE_RENDER_3D)
-        .add_systems<mesh_render_system>(Schedule::RENDER_3D);
+        .add_systems<process_mesh_creation_system>(Schedule::BEFORE_RENDER_3D);
+
+    if (app.is_pipelined()) {
+        app.insert_resource(MeshSnapshot{})
+            .add_systems<mesh_extract_system>(Schedule::EXTRACT)
+            .after<TransformPropagationSet>()
+            .add_systems<mesh_render_snapshot_system>(Schedule::RENDER_3D);
+    } else {
+        app.add_systems<mesh_render_system>(Schedule::RENDER_3D);
+    }
 
     Logger::debug("MeshPlugin built");
 }
@@ -233,7 +233,7 @@ static void post_processing_plugin_resize_system(const r::ecs::Res<r::WindowPlug
 static void post_processing_plugin_end_capture_and_draw(
     const r::ecs::Res<r::PostProcessingPluginConfig> config_ptr,
     const r::ecs::Res<r::WindowPluginConfig> window_config,
-    const r::ecs::Res<r::core::FrameTime> frame_time
+    const r::ecs::Res<r::core::Extracted<r::core::FrameTime>> frame_time
 ) noexcept
 {
     if (!g_render_texture.initialized) {
@@ -257,7 +257,7 @@ static void post_processing_plugin_end_capture_and_draw(
     }
 
     if (active_shader_fx.timeLoc != -1) {
-        const f32 time = frame_time.ptr->global_time;
+        const f32 time = frame_time.ptr->value.global_time;
         SetShaderValue(active_shader_fx.shader, active_shader_fx.timeLoc, &time, SHADER_UNIFORM_FLOAT);
     }
 
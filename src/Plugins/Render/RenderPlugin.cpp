@@ -32,9 +32,9 @@ static void render_plugin_2D_before_render_system(const r::ecs::Res<r::RenderPlu
     ClearBackground(rl_color);
 }
 
-static void render_plugin_3D_before_render_system(const r::ecs::Res<r::Camera3d> &camera) noexcept
+static void render_plugin_3D_before_render_system(const r::ecs::Res<r::core::Extracted<r::Camera3d>> &camera) noexcept
 {
-    BeginMode3D(to_raylib(*camera.ptr));
+    BeginMode3D(to_raylib(camera.ptr->value));
 }
 
 static void render_plugin_3D_after_render_system(void) noexcept
@@ -60,6 +60,7 @@ void r::RenderPlugin::build(r::Application &app)
 {
     app.insert_resource(_config);
     app.insert_resource(_camera)
+        .extract_resource<r::Camera3d>()
         .add_systems<render_plugin_2D_before_render_system>(Schedule::BEFORE_RENDER_2D)
         .add_systems<render_plugin_3D_before_render_system>(Schedule::BEFORE_RENDER_3D)
         .add_systems<render_plugin_3D_after_render_system>(Schedule::AFTER_RENDER_3D)
@@ -3,10 +3,9 @@
 #include <R-Engine/Application.hpp>
 #include <R-Engine/Components/Transform3d.hpp>
 #include <R-Engine/Core/Logger.hpp>
+#include <R-Engine/ECS/Hierarchy.hpp>
 #include <R-Engine/ECS/Resolver.hpp>
 
-#include <deque>
-#include <unordered_map>
 #include <vector>
 
 namespace {// anonymous namespace
@@ -17,19 +16,15 @@ using TransformWithoutGlobal = r::ecs::Query<
         r::ecs::With<r::Transform3d>,
         r::ecs::Without<r::GlobalTransform3d>>;
 
-using OrphelinsQuery = r::ecs::Query<
-    r::ecs::Without<r::ecs::Parent>>;
-
 using TransformComponentsQuery = r::ecs::Query<
     r::ecs::Ref<r::Transform3d>,
     r::ecs::Mut<r::GlobalTransform3d>,
-    r::ecs::Optional<r::ecs::Children>>;
+    r::ecs::Optional<r::ecs::Parent>>;
 
-struct TransformPluginCache {
+struct TransformSlot {
     public:
-        std::unordered_map<r::ecs::Entity, const r::Transform3d *> local;
-        std::unordered_map<r::ecs::Entity, r::GlobalTransform3d *> global;
-        std::unordered_map<r::ecs::Entity, const std::vector<r::ecs::Entity> *> children;
+        const r::Transform3d *local = nullptr;
+        r::GlobalTransform3d *global = nullptr;
 };
 
 // clang-format on
@@ -39,114 +34,52 @@ struct TransformPluginCache {
  */
 
 /**
- * @brief builds a cache of direct component ptr
+ * @brief copies the local transform of every root into its global transform, and records the transform
+ * pointers of every entity in a flat table indexed by entity index
  * @param all_transforms_q query containing all transform-related components
- * @return populated TransformPluginCache
+ * @param slots table to fill, cleared first
  */
-TransformPluginCache transform_build_cache(TransformComponentsQuery &all_transforms_q)
+void transform_update_roots(TransformComponentsQuery &all_transforms_q, std::vector<TransformSlot> &slots)
 {
-    TransformPluginCache cache;
-    const size_t entity_count = all_transforms_q.size();
-
-    cache.local.reserve(entity_count);
-    cache.global.reserve(entity_count);
-    cache.children.reserve(entity_count / 4);///<< idk maybe a quarter of entities have children? ((to avoid realloc))
-
+    slots.clear();
     for (auto it = all_transforms_q.begin(); it != all_transforms_q.end(); ++it) {
-        const auto [local, global, children_opt] = *it;
-        const r::ecs::Entity entity = it.entity();
-
-        cache.local[entity] = local.ptr;
-        cache.global[entity] = global.ptr;
+        const auto [local, global, parent_opt] = *it;
+        const u32 index = r::ecs::entity_index(it.entity());
 
-        if (children_opt.ptr) {
-            cache.children[entity] = &children_opt.ptr->entities;
-        }
-    }
-
-    return cache;
-}
-
-/**
- * @brief initializes root transforms and prepares the queue
- * @param roots_q query to find all root entities
- * @param cache  pre-built transform cache
- * @return deque containing all root entities, ready for traversal.
- */
-std::deque<r::ecs::Entity> transform_get_queue(OrphelinsQuery &roots_q, const TransformPluginCache &cache)
-{
-    std::deque<r::ecs::Entity> queue;
-
-    for (auto it = roots_q.begin(); it != roots_q.end(); ++it) {
-        const r::ecs::Entity entity = it.entity();
-        const auto local_it = cache.local.find(entity);
-
-        if (local_it == cache.local.end()) {
-            continue;
+        if (!parent_opt.ptr) {
+            global.ptr->position = local.ptr->position;
+            global.ptr->rotation = local.ptr->rotation;
+            global.ptr->scale = local.ptr->scale;
         }
-
-        const r::Transform3d *local = local_it->second;
-        const auto global_it = cache.global.find(entity);
-        if (global_it == cache.global.end()) {
-            /* Missing global (component may have been added/removed concurrently) */
-            continue;
+        if (index >= slots.size()) {
+            slots.resize(index + 1);
         }
-
-        r::GlobalTransform3d *global = global_it->second;
-
-        global->position = local->position;
-        global->rotation = local->rotation;
-        global->scale = local->scale;
-
-        queue.push_back(entity);
+        slots[index] = {local.ptr, global.ptr};
     }
-
-    return queue;
 }
 
 /**
- * @brief Breadth-First Search to propagate transforms to all descendants
- * @param queue queue, pre-populated with root entities.
- * @param cache pre-built transform cache.
+ * @brief propagates transforms to all descendants in a single scan of the depth-sorted hierarchy
+ * @info a parent always comes before its children in depth_order(), so its global transform is final
+ * by the time its children read it
  */
-void transform_bfs_propagation(std::deque<r::ecs::Entity> &queue, const TransformPluginCache &cache)
+void transform_propagate_links(const r::ecs::HierarchyIndex &hierarchy, const std::vector<TransformSlot> &slots)
 {
-    while (!queue.empty()) {
-        const r::ecs::Entity parent_entity = queue.front();
-
-        queue.pop_front();
-
-        const auto children_it = cache.children.find(parent_entity);
+    for (const auto &[entity, parent] : hierarchy.depth_order()) {
+        const u32 child_index = r::ecs::entity_index(entity);
+        const u32 parent_index = r::ecs::entity_index(parent);
 
-        if (children_it == cache.children.end()) {
+        if (child_index >= slots.size() || parent_index >= slots.size()) {
             continue;
         }
 
-        const auto parent_global_it = cache.global.find(parent_entity);
-        if (parent_global_it == cache.global.end()) {
-            continue; /* parent global transform missing */
-        }
-
-        const r::GlobalTransform3d &parent_global = *parent_global_it->second;
-        const std::vector<r::ecs::Entity> &child_entities = *children_it->second;
-
-        for (const r::ecs::Entity child_entity : child_entities) {
-            const auto child_local_it = cache.local.find(child_entity);
-            if (child_local_it == cache.local.end()) {
-                continue; /* child local transform missing */
-            }
-            const auto child_global_it = cache.global.find(child_entity);
-            if (child_global_it == cache.global.end()) {
-                continue; /* child global transform missing */
-            }
-
-            const r::Transform3d *child_local = child_local_it->second;
-            r::GlobalTransform3d *child_global = child_global_it->second;
+        const TransformSlot &child = slots[child_index];
+        const TransformSlot &parent_slot = slots[parent_index];
 
-            *child_global = r::GlobalTransform3d::from_local_and_parent(*child_local, parent_global);
-
-            queue.push_back(child_entity);
+        if (!child.global || !parent_slot.global) {
+            continue; /* missing transform on either side */
         }
+        *child.global = r::GlobalTransform3d::from_local_and_parent(*child.local, *parent_slot.global);
     }
 }
 
@@ -167,23 +100,25 @@ static void transform_add_missing_global_system(r::ecs::Commands &commands, Tran
 /**
  * @brief high-level system that orchestrates the transform propagation process
  */
-static void transform_propagate_system(OrphelinsQuery roots_q, TransformComponentsQuery all_transforms_q)
+static void transform_propagate_system(TransformComponentsQuery all_transforms_q, r::ecs::Hierarchy hierarchy)
 {
+    thread_local std::vector<TransformSlot> slots;
+
     if (all_transforms_q.size() == 0) {
         return;
     }
 
-    const TransformPluginCache cache = transform_build_cache(all_transforms_q);
-    std::deque<r::ecs::Entity> queue = transform_get_queue(roots_q, cache);
-
-    transform_bfs_propagation(queue, cache);
+    transform_update_roots(all_transforms_q, slots);
+    transform_propagate_links(*hierarchy.index, slots);
 }
 
 }// namespace
 
 void r::TransformPlugin::build(Application &app)
 {
+    /* the simulation of the frame is final at EXTRACT, so the extracted render data sees the propagated transforms */
     app.add_systems<transform_add_missing_global_system>(r::Schedule::UPDATE)
-        .add_systems<transform_propagate_system>(r::Schedule::BEFORE_RENDER_3D);
+        .add_systems<transform_propagate_system>(r::Schedule::EXTRACT)
+        .in_set<TransformPropagationSet>();
     Logger::debug("TransformPlugin built");
 }
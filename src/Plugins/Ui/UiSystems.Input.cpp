@@ -34,9 +34,6 @@ struct InputData {
         std::unordered_map<r::ecs::Entity, bool> button_enabled;                ///< Button enabled state by entity
 };
 
-/// @brief Threshold value for determining placeholder entities in input system
-static constexpr auto INPUT_PLACEHOLDER_THRESHOLD = std::numeric_limits<r::ecs::Entity>::max() / 2u;
-
 /**
  * @brief Collects and sorts UI elements for input processing
  * @tparam QueryType Type of the ECS query
@@ -98,8 +95,6 @@ static void setup_input_entity_mappings(std::vector<InputItem> &items, InputData
         auto it = data.parent_from_children.find(kv.first);
         if (it != data.parent_from_children.end()) {
             kv.second = it->second;
-        } else if (kv.second >= INPUT_PLACEHOLDER_THRESHOLD) {
-            kv.second = r::ecs::NULL_ENTITY;
         }
     }
 
@@ -108,9 +103,6 @@ static void setup_input_entity_mappings(std::vector<InputItem> &items, InputData
         if (it != data.parents.end()) {
             item.parent = it->second;
         }
-        if (item.parent >= INPUT_PLACEHOLDER_THRESHOLD) {
-            item.parent = r::ecs::NULL_ENTITY;
-        }
     }
 }
 
@@ -35,8 +35,6 @@ struct RenderData {
 
 /// @brief Placeholder value for invalid entity references
 static constexpr auto PLACEHOLDER = std::numeric_limits<r::ecs::Entity>::max();
-/// @brief Threshold value for determining placeholder entities
-static constexpr auto PLACEHOLDER_THRESHOLD = std::numeric_limits<r::ecs::Entity>::max() / 2u;
 
 /**
  * @brief Computes the intersection of two rectangles
@@ -89,7 +87,7 @@ static auto resolve_parent_entity(const RenderData &data, r::ecs::Entity child,
  */
 static auto resolve_parent_for_foreground(const RenderData &data, r::ecs::Entity child, r::ecs::Entity parent) -> r::ecs::Entity
 {
-    if (parent < PLACEHOLDER_THRESHOLD)
+    if (parent != PLACEHOLDER)
         return parent;
     auto parent_it = data.parent_from_children.find(child);
     if (parent_it != data.parent_from_children.end())
@@ -656,7 +654,7 @@ static void render_foreground(QueryType &q, const RenderData &data, r::ecs::ResM
     }
 }
 
-void render_system(r::ecs::Res<UiPluginConfig> cfg, r::ecs::Res<r::Camera3d> cam, r::ecs::Res<r::UiInputState> input,
+void render_system(r::ecs::Res<UiPluginConfig> cfg, r::ecs::Res<r::core::Extracted<r::Camera3d>> cam, r::ecs::Res<r::UiInputState> input,
     r::ecs::Res<r::UiTheme> theme, r::ecs::ResMut<r::UiTextures> textures, r::ecs::ResMut<r::UiFonts> fonts,
     r::ecs::Query<r::ecs::Ref<r::UiNode>, r::ecs::Ref<r::ComputedLayout>, r::ecs::Optional<r::Style>, r::ecs::Optional<r::Visibility>,
         r::ecs::Optional<r::ecs::Parent>, r::ecs::Optional<r::UiText>, r::ecs::Optional<r::UiImage>, r::ecs::Optional<r::UiButton>,
@@ -38,13 +38,10 @@ void scroll_input_system(r::ecs::Res<r::UiInputState> state, r::ecs::Res<r::User
         }
     }
 
-    constexpr auto PLACEHOLDER_THRESHOLD = std::numeric_limits<r::ecs::Entity>::max() / 2u;
     for (auto &kv : parents) {
         auto it = parent_from_children.find(kv.first);
         if (it != parent_from_children.end()) {
             kv.second = it->second;
-        } else if (kv.second >= PLACEHOLDER_THRESHOLD) {
-            kv.second = r::ecs::NULL_ENTITY;
         }
     }
 
@@ -5,15 +5,25 @@
 #include <R-Engine/Core/ThreadPool.hpp>
 
 #include <R-Engine/ECS/Command.hpp>
+#include <R-Engine/ECS/Event.hpp>
 #include <R-Engine/ECS/Scene.hpp>
 
+#include <algorithm>
 #include <atomic>
-#include <future>
+#include <chrono>
+#include <exception>
+#include <mutex>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 // clang-format off
 
+/* weight of the last run in the moving average of a system run time */
+static constexpr f64 RUN_TIME_SMOOTHING = 0.1;
+/* the dag ranks are refreshed from the measured times every that many runs */
+static constexpr u32 RANKING_PERIOD = 64;
+
 /**
  * static private helpers
  */
@@ -24,8 +34,17 @@ namespace {
  * select system for stage helpers
  */
 
+/**
+ * @brief check if an access includes the whole Scene (a Scene & parameter), which conflicts with everything
+ */
+static bool scheduler_system_is_exclusive(const r::sys::Access &resource_access)
+{
+    return resource_access.writes.count(typeid(r::ecs::Scene)) != 0;
+}
+
 /**
  * @brief check if a system has access conflicts (read/write) with the accesses already present in a stage.
+ * @info a system taking the Scene conflicts with any other, even one that declares no access
  */
 static bool scheduler_system_access_conflict(
     const r::sys::SystemNode &node,
@@ -33,6 +52,9 @@ static bool scheduler_system_access_conflict(
     const r::sys::Access &stage_resource_access
 )
 {
+    if (scheduler_system_is_exclusive(node.resource_access) || scheduler_system_is_exclusive(stage_resource_access)) {
+        return true;
+    }
     for (const auto &write : node.component_access.writes) {
         if (stage_component_access.reads.count(write) || stage_component_access.writes.count(write)) {
             return true;
@@ -56,24 +78,6 @@ static bool scheduler_system_access_conflict(
     return false;
 }
 
-/**
- * @brief try to form a main thread stage containing a single "main thread only" system.
-*/
-static std::vector<const r::sys::SystemNode *> scheduler_system_select_main_thread_stage(
-    const std::vector<r::sys::SystemTypeId> &ready_systems,
-    const r::sys::ScheduleGraph &graph
-)
-{
-    for (const auto &id : ready_systems) {
-        const auto &node = graph.nodes.at(id);
-
-        if (node.is_main_thread_only) {
-            return {&node}; ///<< a main-thread countains only ONE system
-        }
-    }
-    return {};
-}
-
 /**
  @brief Forms an execution stage by aggressively adding all compatible parallel systems.
  */
@@ -90,9 +94,9 @@ static std::vector<const r::sys::SystemNode *> scheduler_system_select_parallel_
         const auto &node = graph.nodes.at(id);
 
         /**
-         * @info if no conflict -> add system to stage
+         * @info if no conflict -> add system to stage, the first one always fits
          */
-        if (!scheduler_system_access_conflict(node, stage_component_access, stage_resource_access)) {
+        if (stage_nodes.empty() || !scheduler_system_access_conflict(node, stage_component_access, stage_resource_access)) {
             stage_nodes.push_back(&node);
             stage_component_access.reads.insert(node.component_access.reads.begin(), node.component_access.reads.end());
             stage_component_access.writes.insert(node.component_access.writes.begin(), node.component_access.writes.end());
@@ -104,64 +108,239 @@ static std::vector<const r::sys::SystemNode *> scheduler_system_select_parallel_
 }
 
 /**
- * execute graph helpers
+ * @brief check if two systems may not run at the same time
+ * @info main thread only systems all run on the same thread, they are chained to keep their dispatch order
  */
+static bool scheduler_system_must_order(const r::sys::SystemNode &earlier, const r::sys::SystemNode &later)
+{
+    return (earlier.is_main_thread_only && later.is_main_thread_only)
+        || scheduler_system_access_conflict(later, earlier.component_access, earlier.resource_access);
+}
 
 /**
-* @brief execute a single system stage on the main thread.
+ * @brief compile the stages into a DAG, in dispatch order
+ * @info an edge always goes from an earlier system to a later one, so the dispatch order is a topological order
  */
-static void scheduler_system_execute_main_thread_stage(
-    const r::sys::SystemNode *node,
-    r::ecs::Scene &scene, r::ecs::CommandBuffer &main_command_buffer)
+static void scheduler_system_build_dag(
+    r::sys::ScheduleGraph &graph,
+    const std::unordered_map<r::sys::SystemTypeId, std::vector<r::sys::SystemTypeId>> &adj_list
+)
 {
-    if (!node->condition || node->condition(scene)) {
-        node->func(scene, main_command_buffer);
+    graph.dag.clear();
+    for (const auto &stage : graph.execution_stages) {
+        for (const auto *node : stage) {
+            graph.dag.push_back({node, {}, 0});
+        }
+    }
+
+    for (size_t later = 0; later < graph.dag.size(); ++later) {
+        const r::sys::SystemNode &later_node = *graph.dag[later].node;
+
+        for (size_t earlier = 0; earlier < later; ++earlier) {
+            const r::sys::SystemNode &earlier_node = *graph.dag[earlier].node;
+            const auto it = adj_list.find(earlier_node.id);
+            const bool ordered = it != adj_list.end() && std::find(it->second.begin(), it->second.end(), later_node.id) != it->second.end();
+
+            if (ordered || scheduler_system_must_order(earlier_node, later_node)) {
+                graph.dag[earlier].successors.push_back(static_cast<u32>(later));
+                ++graph.dag[later].predecessors;
+            }
+        }
     }
 }
 
 /**
- * @brief execute a parallel stage helper
+ * execute graph helpers
  */
-static void scheduler_system_execute_parallel_stage(
-    const std::vector<const r::sys::SystemNode *> &stage,
-    r::core::ThreadPool &thread_pool,
-    r::ecs::Scene &scene,
-    const std::vector<std::unique_ptr<r::ecs::CommandBuffer>> &thread_local_buffers
-)
-{
-    thread_local size_t thread_idx = 0;
-    static std::atomic<size_t> next_thread_idx{1};
 
-    std::vector<std::future<void>> futures;
-    futures.reserve(stage.size());
+/* index of the thread local command buffer of the current thread, 0 until the thread first runs a system */
+thread_local size_t tl_buffer_index = 0;
+std::atomic<size_t> g_next_buffer_index{1};
+
+}// namespace
 
-    for (const auto *node_ptr : stage) {
-        futures.emplace_back(thread_pool.enqueue([&, node_ptr] {
-            if (thread_idx == 0) {
-                thread_idx = next_thread_idx.fetch_add(1);
+/**
+ * @brief state of one run of a compiled graph, shared by the main thread and the system tasks
+ * @details pending holds the number of predecessors of each system that did not complete yet, the one
+ * completing the last predecessor dispatches the system. signal is bumped whenever the main thread has
+ * something to do: a main thread only system became ready, or the whole graph completed.
+ * it lives as long as the Scheduler, so a task touching signal after the run returned stays harmless.
+ */
+struct r::core::Scheduler::Execution {
+        const std::vector<sys::ScheduledSystem> *dag = nullptr;
+        ecs::Scene *scene = nullptr;
+        ecs::CommandBuffer *main_command_buffer = nullptr;
+        const std::vector<std::unique_ptr<ecs::CommandBuffer>> *thread_local_buffers = nullptr;
+        core::ThreadPool *thread_pool = nullptr;
+        u64 first_source = 0;
+
+        std::unique_ptr<std::atomic<u32>[]> pending;
+        size_t pending_capacity = 0;
+        std::vector<u64> durations; /**< Run time of each system in ns, written by the thread that ran it. */
+        std::vector<u32> roots;
+        std::atomic<size_t> remaining{0};
+        std::atomic<u32> signal{0};
+
+        std::mutex main_mutex;
+        std::vector<u32> main_ready;
+
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+
+        void prepare(size_t count)
+        {
+            if (pending_capacity < count) {
+                pending = std::make_unique<std::atomic<u32>[]>(count);
+                pending_capacity = count;
             }
-            if (!node_ptr->condition || node_ptr->condition(scene)) {
-                node_ptr->func(scene, *thread_local_buffers[thread_idx % thread_local_buffers.size()]);
+            for (size_t i = 0; i < count; ++i) {
+                pending[i].store((*dag)[i].predecessors, std::memory_order_relaxed);
             }
-        }));
-    }
+            durations.assign(count, 0);
+            remaining.store(count, std::memory_order_relaxed);
+            error = nullptr;
+            failed.store(false, std::memory_order_relaxed);
+        }
 
-    for (auto &future : futures) {
-        future.get();
-    }
-}
+        /**
+         * @brief evaluates the run condition of a ready system and hands it to the thread that runs it
+         * @details every predecessor completed, so the condition is evaluated right away on the releasing
+         * thread, with its buffer: a skipped system costs neither a task nor a round trip to the main thread.
+         */
+        void dispatch(u32 index, ecs::CommandBuffer &buffer)
+        {
+            if (!_should_run(index, buffer)) {
+                complete(index, buffer);
+                return;
+            }
+            if ((*dag)[index].node->is_main_thread_only) {
+                {
+                    const std::scoped_lock lock(main_mutex);
+                    main_ready.push_back(index);
+                }
+                _wake_main();
+                return;
+            }
+            /* the handle is dropped right away, completion is tracked through the successors */
+            thread_pool->enqueue([this, index] {
+                if (tl_buffer_index == 0) {
+                    tl_buffer_index = g_next_buffer_index.fetch_add(1);
+                }
+                run(index, *(*thread_local_buffers)[tl_buffer_index % thread_local_buffers->size()]);
+            });
+        }
 
-}// namespace
+        /**
+         * @brief runs a dispatched system, then releases its successors
+         * @info once a system threw, the following ones are skipped but still completed, so the run drains.
+         * a worker waiting on a task inside a system may run another system on the same buffer, the source
+         * of the waiting system is restored afterwards so its later commands keep their place in the merge.
+         */
+        void run(u32 index, ecs::CommandBuffer &buffer)
+        {
+            const sys::SystemNode *node = (*dag)[index].node;
+            const auto start = std::chrono::steady_clock::now();
+            const u64 previous_source = buffer.get_source();
+            const u64 previous_batch = std::exchange(ecs::current_event_batch(), 0);
+
+            buffer.set_source(first_source + index);
+            if (!failed.load(std::memory_order_relaxed)) {
+                try {
+                    node->func(*scene, buffer, node->state.get());
+                } catch (...) {
+                    _fail();
+                }
+            }
+            buffer.set_source(previous_source);
+            ecs::current_event_batch() = previous_batch;
+            durations[index] = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            complete(index, buffer);
+        }
+
+        /**
+         * @brief releases the successors of a system that ran or was skipped
+         */
+        void complete(u32 index, ecs::CommandBuffer &buffer)
+        {
+            /* successors are sorted by increasing rank: the last one pushed is the first one this worker pops */
+            for (const u32 successor : (*dag)[index].successors) {
+                if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    dispatch(successor, buffer);
+                }
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                _wake_main();
+            }
+        }
+
+        bool pop_main(u32 &index)
+        {
+            const std::scoped_lock lock(main_mutex);
+
+            if (main_ready.empty()) {
+                return false;
+            }
+            index = main_ready.back();
+            main_ready.pop_back();
+            return true;
+        }
+
+    private:
+        bool _should_run(u32 index, ecs::CommandBuffer &buffer)
+        {
+            const sys::SystemNode *node = (*dag)[index].node;
+            const u64 previous_source = buffer.get_source();
+            bool should_run = false;
+
+            if (failed.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            buffer.set_source(first_source + index);
+            try {
+                should_run = node->should_run(*scene, buffer);
+            } catch (...) {
+                _fail();
+            }
+            buffer.set_source(previous_source);
+            return should_run;
+        }
+
+        void _fail() noexcept
+        {
+            const std::scoped_lock lock(error_mutex);
+
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed.store(true, std::memory_order_relaxed);
+        }
+
+        void _wake_main() noexcept
+        {
+            signal.fetch_add(1, std::memory_order_release);
+            signal.notify_one();
+        }
+};
 
 /**
  * public
  */
 
-r::core::Scheduler::Scheduler(core::ThreadPool &thread_pool) : _thread_pool(thread_pool)
+r::core::Scheduler::Scheduler(core::ThreadPool &thread_pool) : _thread_pool(thread_pool), _execution(std::make_unique<Execution>())
 {
     /* __ctor__ */
 }
 
+r::core::Scheduler::~Scheduler() = default;
+
+f64 r::core::Scheduler::get_average_run_time(const sys::SystemTypeId &id) const noexcept
+{
+    const auto it = _run_times.find(id);
+
+    return it != _run_times.end() ? it->second : 0.0;
+}
+
 void r::core::Scheduler::run(
     sys::ScheduleGraph &graph,
     ecs::Scene &scene,
@@ -172,7 +351,37 @@ void r::core::Scheduler::run(
     if (graph.dirty) {
         _sort_graph(graph);
     }
-    _execute_graph(graph, scene, main_command_buffer, thread_local_buffers);
+    _prioritize(graph.dag, graph.runs_since_ranking);
+    _execute(graph.dag, scene, main_command_buffer, thread_local_buffers);
+}
+
+void r::core::Scheduler::run_chain(
+    const std::vector<sys::ScheduleGraph *> &graphs,
+    ecs::Scene &scene,
+    ecs::CommandBuffer &main_command_buffer,
+    const std::vector<std::unique_ptr<ecs::CommandBuffer>> &thread_local_buffers
+)
+{
+    for (auto *graph : graphs) {
+        if (graph->dirty) {
+            _sort_graph(*graph);
+        }
+    }
+
+    const auto same_graphs = [&graphs](const Chain &chain) {
+        return std::equal(chain.graphs.begin(), chain.graphs.end(), graphs.begin(), graphs.end());
+    };
+    auto it = std::find_if(_chains.begin(), _chains.end(), same_graphs);
+
+    if (it == _chains.end()) {
+        it = _chains.insert(_chains.end(), Chain{{graphs.begin(), graphs.end()}, {}, {}});
+    }
+    if (!std::equal(it->versions.begin(), it->versions.end(), graphs.begin(), graphs.end(),
+            [](u64 version, const sys::ScheduleGraph *graph) { return version == graph->version; })) {
+        _build_chain(*it, graphs);
+    }
+    _prioritize(it->dag, it->runs_since_ranking);
+    _execute(it->dag, scene, main_command_buffer, thread_local_buffers);
 }
 
 /**
@@ -262,6 +471,9 @@ void r::core::Scheduler::_sort_graph(sys::ScheduleGraph &graph)
         }
         graph.execution_stages.push_back(std::move(systems_for_stage));
     }
+    scheduler_system_build_dag(graph, adj_list);
+    ++graph.version;
+    graph.runs_since_ranking = 0;
     graph.dirty = false;
 }
 
@@ -270,33 +482,137 @@ std::vector<const r::sys::SystemNode *> r::core::Scheduler::_select_systems_for_
     const sys::ScheduleGraph &graph
 )
 {
-    auto main_thread_stage = scheduler_system_select_main_thread_stage(ready_systems, graph);
-
-    if (!main_thread_stage.empty()) {
-        return main_thread_stage;
-    }
+    /* main thread only systems are packed like the others, the dag keeps them off the workers */
     return scheduler_system_select_parallel_stage(ready_systems, graph);
 }
 
-void r::core::Scheduler::_execute_graph(
-    const sys::ScheduleGraph &graph,
+void r::core::Scheduler::_execute(
+    const std::vector<sys::ScheduledSystem> &dag,
     ecs::Scene &scene,
     ecs::CommandBuffer &main_command_buffer,
     const std::vector<std::unique_ptr<ecs::CommandBuffer>> &thread_local_buffers
 )
 {
-    for (const auto &stage : graph.execution_stages) {
+    const size_t count = dag.size();
+    Execution &execution = *_execution;
+
+    if (count == 0) {
+        return;
+    }
+
+    /**
+    * @info sources are handed out in dispatch order, so the command order does not depend on
+    * which thread (and thus which thread local buffer) runs which system.
+    */
+    execution.dag = &dag;
+    execution.scene = &scene;
+    execution.main_command_buffer = &main_command_buffer;
+    execution.thread_local_buffers = &thread_local_buffers;
+    execution.thread_pool = &_thread_pool;
+    execution.first_source = _next_source;
+    _next_source += count;
+    execution.prepare(count);
+
+    /**
+    * @info roots are stolen in the order they are enqueued, so the longest paths are started first
+    */
+    execution.roots.clear();
+    for (u32 index = 0; index < count; ++index) {
+        if (dag[index].predecessors == 0) {
+            execution.roots.push_back(index);
+        }
+    }
+    std::stable_sort(execution.roots.begin(), execution.roots.end(), [&dag](u32 a, u32 b) { return dag[a].rank > dag[b].rank; });
+    for (const u32 index : execution.roots) {
+        execution.dispatch(index, main_command_buffer);
+    }
+
+    /**
+    * @info the calling thread runs the main thread only systems as they become ready, until the graph completed
+    */
+    for (;;) {
+        const u32 seen = execution.signal.load(std::memory_order_acquire);
+        u32 index = 0;
+
+        while (execution.pop_main(index)) {
+            execution.run(index, main_command_buffer);
+        }
+        if (execution.remaining.load(std::memory_order_acquire) == 0) {
+            break;
+        }
+        execution.signal.wait(seen, std::memory_order_acquire);
+    }
+    _record_run_times(dag);
+
+    if (execution.error) {
+        std::rethrow_exception(std::exchange(execution.error, nullptr));
+    }
+}
+
+void r::core::Scheduler::_build_chain(Chain &chain, const std::vector<sys::ScheduleGraph *> &graphs)
+{
+    chain.versions.clear();
+    chain.dag.clear();
+    chain.runs_since_ranking = 0;
+    for (const auto *graph : graphs) {
+        const size_t first = chain.dag.size();
+
+        chain.versions.push_back(graph->version);
+        for (const auto &system : graph->dag) {
+            chain.dag.push_back(system);
+            for (u32 &successor : chain.dag.back().successors) {
+                successor += static_cast<u32>(first);
+            }
+        }
+
+        /**
+        * @info no ordering constraint crosses schedules, only conflicts and the main thread order do
+        */
+        for (size_t later = first; later < chain.dag.size(); ++later) {
+            for (size_t earlier = 0; earlier < first; ++earlier) {
+                if (scheduler_system_must_order(*chain.dag[earlier].node, *chain.dag[later].node)) {
+                    chain.dag[earlier].successors.push_back(static_cast<u32>(later));
+                    ++chain.dag[later].predecessors;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief refreshes the upward rank of every system, HEFT style, and sorts the successors by rank
+ * @info a system that never ran still weighs 1 µs, so the length of its path counts
+ */
+void r::core::Scheduler::_prioritize(std::vector<sys::ScheduledSystem> &dag, u32 &runs_since_ranking) const
+{
+    if (runs_since_ranking++ % RANKING_PERIOD != 0) {
+        return;
+    }
 
-        if (stage.empty()) {
-            continue;
+    /* edges always go forward, so walking backwards sees every successor before its predecessors */
+    for (size_t i = dag.size(); i-- > 0;) {
+        f64 longest = 0.0;
+
+        for (const u32 successor : dag[i].successors) {
+            longest = std::max(longest, dag[successor].rank);
         }
+        dag[i].rank = std::max(get_average_run_time(dag[i].node->id), 1.0) + longest;
+    }
+    for (auto &system : dag) {
+        std::stable_sort(system.successors.begin(), system.successors.end(), [&dag](u32 a, u32 b) { return dag[a].rank < dag[b].rank; });
+    }
+}
+
+void r::core::Scheduler::_record_run_times(const std::vector<sys::ScheduledSystem> &dag)
+{
+    const std::vector<u64> &durations = _execution->durations;
 
-        const bool is_main_thread_stage = stage.size() == 1 && stage[0]->is_main_thread_only;
+    for (size_t i = 0; i < dag.size(); ++i) {
+        const f64 sample = static_cast<f64>(durations[i]) / 1000.0;
+        const auto [it, inserted] = _run_times.try_emplace(dag[i].node->id, sample);
 
-        if (is_main_thread_stage) {
-            scheduler_system_execute_main_thread_stage(stage[0], scene, main_command_buffer);
-        } else {
-            scheduler_system_execute_parallel_stage(stage, _thread_pool, scene, thread_local_buffers);
+        if (!inserted) {
+            it->second += RUN_TIME_SMOOTHING * (sample - it->second);
         }
     }
 }
@@ -15,6 +15,22 @@ r::sys::SystemNode::SystemNode(const std::string &p_name, SystemTypeId p_id, Sys
     /* __ctor__ */
 }
 
+bool r::sys::SystemNode::should_run(ecs::Scene &scene, ecs::CommandBuffer &cmd) const
+{
+    bool result = true;
+
+    for (usize i = 0; i < conditions.size(); ++i) {
+        const RunCondition &condition = conditions[i];
+
+        /* true || x and false && x are already decided */
+        if (i > 0 && result == (condition.join == RunCondition::Join::Or)) {
+            continue;
+        }
+        result = condition.predicate(scene, cmd) != condition.negated;
+    }
+    return result;
+}
+
 r::sys::SystemSet::SystemSet(const std::string &pname, SystemSetId pid) noexcept : name(pname), id(pid)
 {
     /* __ctor__ */
@@ -4,8 +4,15 @@
 #include <R-Engine/Core/States.hpp>
 #include <R-Engine/ECS/Event.hpp>
 #include <R-Engine/ECS/RunConditions.hpp>
+#include <R-Engine/Systems/Scheduler.hpp>
 #include <criterion/redirect.h>
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
 // --- Setup ---
 
 static void _redirect_all_stdout()
@@ -130,3 +137,457 @@ Test(Scheduler, RunIfConditions, .init = _redirect_all_stdout)
 
     cr_assert_eq(tracker.run_if_on_event_ran, 1, "on_event should run exactly once, on the frame an event was sent (frame 3).");
 }
+
+static std::vector<int> rendered_frames;
+
+void sys_render_frame(r::ecs::Res<TestTracker> tracker)
+{
+    rendered_frames.push_back(tracker.ptr->frame_counter);
+}
+
+Test(Scheduler, PipelinedFramesRenderThePreviousUpdate, .init = _redirect_all_stdout)
+{
+    r::Application::quit = false;
+    rendered_frames.clear();
+
+    r::Application app;
+    app.set_pipelined(true)
+        .insert_resource(TestTracker{})
+        .init_state(TestState::A)
+        .add_events<TestEvent>()
+        .add_systems<sys_in_state_a>(r::Schedule::UPDATE)
+        .run_if<r::run_conditions::in_state<TestState::A>>()
+        .add_systems<sys_state_changed>(r::Schedule::UPDATE)
+        .run_if<r::run_conditions::state_changed<TestState>>()
+        .add_systems<sys_resource_exists>(r::Schedule::UPDATE)
+        .run_if<r::run_conditions::resource_exists<TestResource>>()
+        .add_systems<sys_on_event>(r::Schedule::UPDATE)
+        .run_if<r::run_conditions::on_event<TestEvent>>()
+        .add_systems<driver_system>(r::Schedule::UPDATE)
+        .add_systems<sys_render_frame>(r::Schedule::RENDER_2D)
+        .run();
+
+    const auto &tracker = *app.get_resource_ptr<TestTracker>();
+
+    /* overlapping the render with the next UPDATE changes nothing the UPDATE systems can observe */
+    cr_assert_eq(tracker.run_if_in_state_a_ran, 4);
+    cr_assert_eq(tracker.run_if_state_changed_ran, 1);
+    cr_assert_eq(tracker.run_if_resource_exists_ran, 3);
+    cr_assert_eq(tracker.run_if_on_event_ran, 1);
+
+    /* the render of a frame runs before the UPDATE of the next one it conflicts with, every frame is rendered */
+    cr_assert(rendered_frames == (std::vector<int>{1, 2, 3, 4, 5, 6}));
+}
+
+struct PipelineScore {
+        int value = 0;
+};
+
+struct PipelineExitMarker {
+        bool exited = false;
+};
+
+static std::vector<f32> updated_times;
+static std::vector<f32> extracted_times;
+static std::vector<int> extracted_scores;
+static std::vector<bool> rendered_exits;
+
+void sys_pipeline_driver(r::ecs::ResMut<PipelineScore> score, r::ecs::ResMut<r::NextState<TestState>> next_state,
+    r::ecs::Res<r::core::FrameTime> time)
+{
+    score.ptr->value++;
+    updated_times.push_back(time.ptr->global_time);
+    if (score.ptr->value == 3) {
+        next_state.ptr->set(TestState::B);
+    }
+    if (score.ptr->value == 5) {
+        r::Application::quit = true;
+    }
+}
+
+void sys_pipeline_exit(r::ecs::ResMut<PipelineExitMarker> marker)
+{
+    marker.ptr->exited = true;
+}
+
+void sys_pipeline_render(r::ecs::Res<r::core::Extracted<PipelineScore>> score, r::ecs::Res<r::core::Extracted<r::core::FrameTime>> time,
+    r::ecs::Res<PipelineExitMarker> marker)
+{
+    extracted_scores.push_back(score.ptr->value.value);
+    extracted_times.push_back(time.ptr->value.global_time);
+    rendered_exits.push_back(marker.ptr->exited);
+}
+
+Test(Scheduler, PipelinedFramesRenderWhatWasExtractedAtTheEndOfTheFrame, .init = _redirect_all_stdout)
+{
+    r::Application::quit = false;
+    updated_times.clear();
+    extracted_times.clear();
+    extracted_scores.clear();
+    rendered_exits.clear();
+
+    r::Application app;
+    app.set_pipelined(true)
+        .insert_resource(PipelineScore{})
+        .insert_resource(PipelineExitMarker{})
+        .extract_resource<PipelineScore>()
+        .init_state(TestState::A)
+        .add_systems<sys_pipeline_driver>(r::Schedule::UPDATE)
+        .add_systems<sys_pipeline_exit>(r::OnExit(TestState::A))
+        .add_systems<sys_pipeline_render>(r::Schedule::RENDER_2D)
+        .run();
+
+    /* frame N is rendered with its own copies, not with what the start of frame N + 1 wrote */
+    cr_assert(extracted_scores == (std::vector<int>{1, 2, 3, 4, 5}));
+    cr_assert(extracted_times == updated_times);
+
+    /* the OnExit requested on frame 3 runs at the start of frame 4, after frame 3 was rendered */
+    cr_assert(rendered_exits == (std::vector<bool>{false, false, false, true, true}));
+}
+
+void sys_pipeline_score_until_quit(r::ecs::ResMut<PipelineScore> score)
+{
+    if (++score.ptr->value == 3) {
+        r::Application::quit = true;
+    }
+}
+
+void sys_pipeline_record_score(r::ecs::Res<r::core::Extracted<PipelineScore>> score)
+{
+    extracted_scores.push_back(score.ptr->value.value);
+}
+
+Test(Scheduler, ExtractingAMissingResourceStartsFromADefault, .init = _redirect_all_stdout)
+{
+    r::Application::quit = false;
+    extracted_scores.clear();
+
+    r::Application app;
+    app.extract_resource<PipelineScore>()
+        .insert_resource(PipelineScore{})
+        .add_systems<sys_pipeline_score_until_quit>(r::Schedule::UPDATE)
+        .add_systems<sys_pipeline_record_score>(r::Schedule::RENDER_2D);
+
+    cr_assert_not_null(app.get_resource_ptr<r::core::Extracted<PipelineScore>>());
+    app.run();
+    cr_assert(extracted_scores == (std::vector<int>{1, 2, 3}));
+}
+
+static int predicate_calls = 0;
+
+static bool predicate_true(r::ecs::Scene &, r::ecs::CommandBuffer &)
+{
+    ++predicate_calls;
+    return true;
+}
+
+static bool predicate_false(r::ecs::Scene &, r::ecs::CommandBuffer &)
+{
+    ++predicate_calls;
+    return false;
+}
+
+Test(Scheduler, RunConditionsFoldLeftToRight)
+{
+    using Join = r::sys::RunCondition::Join;
+    r::ecs::Scene scene;
+    r::ecs::CommandBuffer cmd(&scene);
+    r::sys::SystemNode node;
+
+    cr_assert(node.should_run(scene, cmd), "A system without conditions always runs");
+
+    /* (false && true) || true */
+    node.conditions = {{predicate_false, Join::And, false}, {predicate_true, Join::And, false}, {predicate_true, Join::Or, false}};
+    predicate_calls = 0;
+    cr_assert(node.should_run(scene, cmd));
+    cr_assert_eq(predicate_calls, 2, "false && x is decided without evaluating x");
+
+    /* !true || false */
+    node.conditions = {{predicate_true, Join::And, true}, {predicate_false, Join::Or, false}};
+    cr_assert_not(node.should_run(scene, cmd));
+}
+
+// --- Schedule graphs ---
+
+/**
+* @brief Everything a schedule graph needs to run outside of an Application.
+* @details Holds one command buffer per worker, like the Application does.
+*/
+struct GraphRunner {
+    public:
+        explicit GraphRunner(std::size_t workers) : pool(workers), scheduler(pool), main_buffer(&scene)
+        {
+            for (std::size_t i = 0; i < workers; ++i) {
+                buffers.push_back(std::make_unique<r::ecs::CommandBuffer>(&scene));
+            }
+        }
+
+        void run(r::sys::ScheduleGraph &graph)
+        {
+            scheduler.run(graph, scene, main_buffer, buffers);
+        }
+
+        r::core::ThreadPool pool;
+        r::core::Scheduler scheduler;
+        r::ecs::Scene scene;
+        r::ecs::CommandBuffer main_buffer;
+        std::vector<std::unique_ptr<r::ecs::CommandBuffer>> buffers;
+};
+
+/**
+* @brief Adds the system @p Tag to @p graph and returns its id.
+* @details @p func defaults to @p Tag itself, it only differs when the tag is not a plain system function.
+*/
+template<auto Tag>
+static r::sys::SystemTypeId add_node(r::sys::ScheduleGraph &graph, const std::string &name,
+    std::vector<r::sys::SystemTypeId> dependencies = {}, r::sys::SystemFn func = Tag)
+{
+    const r::sys::SystemTypeId id(typeid(r::sys::SystemTag<Tag>));
+
+    graph.nodes.emplace(id, r::sys::SystemNode(name, id, func, std::move(dependencies)));
+    return id;
+}
+
+static std::thread::id predicate_thread;
+static std::atomic<int> gated_runs{0};
+static std::atomic<bool> released_ran{false};
+
+static bool predicate_record_thread(r::ecs::Scene &, r::ecs::CommandBuffer &)
+{
+    predicate_thread = std::this_thread::get_id();
+    return false;
+}
+
+static void sys_gated(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    gated_runs.fetch_add(1);
+}
+
+static void sys_released(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    released_ran.store(true);
+}
+
+Test(Scheduler, FalseConditionsAreEvaluatedWithoutEnqueuingTheSystem)
+{
+    GraphRunner runner(2);
+    r::sys::ScheduleGraph graph;
+    const auto gated = add_node<sys_gated>(graph, "gated");
+
+    add_node<sys_released>(graph, "released", {gated});
+    graph.nodes.at(gated).conditions = {{predicate_record_thread, r::sys::RunCondition::Join::And, false}};
+
+    /* the gated system is a root, so its condition is evaluated by the thread dispatching the roots */
+    runner.run(graph);
+    cr_assert_eq(predicate_thread, std::this_thread::get_id(), "the condition is evaluated before any task is enqueued");
+    cr_assert_eq(gated_runs.load(), 0);
+    cr_assert(released_ran.load(), "the successors of a skipped system are released");
+}
+
+// --- DAG execution ---
+
+static std::atomic<bool> follower_ran{false};
+static bool slow_saw_follower = false;
+static std::chrono::milliseconds slow_wait{1000};
+
+struct SharedCounter {
+};
+
+static void sys_slow(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    /* only completes early if follower_ran does not wait for the whole first stage */
+    const auto deadline = std::chrono::steady_clock::now() + slow_wait;
+
+    while (!follower_ran.load() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    slow_saw_follower = follower_ran.load();
+}
+
+static void sys_leader(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+}
+
+static void sys_follower(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    follower_ran.store(true);
+}
+
+Test(Scheduler, SystemsStartOnceTheirOwnPredecessorsAreDone)
+{
+    GraphRunner runner(2);
+    r::sys::ScheduleGraph graph;
+    const auto slow = add_node<sys_slow>(graph, "slow");
+    const auto leader = add_node<sys_leader>(graph, "leader");
+    const auto follower = add_node<sys_follower>(graph, "follower", {leader});
+
+    /* slow and leader share the first stage, follower is alone in the second one */
+    runner.run(graph);
+    cr_assert(slow_saw_follower, "follower only waits for leader, not for the stage of slow");
+
+    /* slow and follower both write the counter, they must be ordered even though nothing links them */
+    graph.nodes.at(slow).resource_access.writes.insert(typeid(SharedCounter));
+    graph.nodes.at(follower).resource_access.writes.insert(typeid(SharedCounter));
+    graph.dirty = true;
+    follower_ran.store(false);
+    /* slow now always waits out its deadline, a short one is enough for an overlapping follower to show up */
+    slow_wait = std::chrono::milliseconds(50);
+    runner.run(graph);
+    cr_assert_not(slow_saw_follower, "conflicting systems never overlap");
+}
+
+static std::atomic<bool> pinned_started{false};
+static std::atomic<bool> worker_done{false};
+static bool pinned_saw_worker = false;
+static std::thread::id pinned_thread;
+
+static bool wait_for(const std::atomic<bool> &flag)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    while (!flag.load() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    return flag.load();
+}
+
+static void sys_pinned(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    pinned_thread = std::this_thread::get_id();
+    pinned_started.store(true);
+    pinned_saw_worker = wait_for(worker_done);
+}
+
+static void sys_worker(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    wait_for(pinned_started);
+    worker_done.store(true);
+}
+
+Test(Scheduler, MainThreadSystemsOverlapTheNextSchedule)
+{
+    GraphRunner runner(2);
+    r::sys::ScheduleGraph render;
+    r::sys::ScheduleGraph cleanup;
+
+    render.nodes.at(add_node<sys_pinned>(render, "pinned")).is_main_thread_only = true;
+    add_node<sys_worker>(cleanup, "worker");
+
+    /* each system waits on the other, they only both finish early if they overlap */
+    runner.scheduler.run_chain({&render, &cleanup}, runner.scene, runner.main_buffer, runner.buffers);
+    cr_assert(pinned_saw_worker, "the worker system of the next schedule runs while the main thread renders");
+    cr_assert_eq(pinned_thread, std::this_thread::get_id(), "main thread only systems run on the calling thread");
+}
+
+static r::core::ThreadPool *nesting_pool = nullptr;
+
+struct LastWriter {
+        char system = 0;
+};
+
+static void sys_spawner(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+}
+
+static void sys_waiting(r::ecs::Scene &, r::ecs::CommandBuffer &buffer, void *)
+{
+    r::core::TaskHandle<void> nested;
+
+    /* submitted from outside the pool, so the worker finds the other ready system first while it waits */
+    std::thread([&nested] { nested = nesting_pool->enqueue([] {}); }).join();
+    nested.wait();
+    buffer.insert_resource(LastWriter{'w'});
+}
+
+static void sys_helped(r::ecs::Scene &, r::ecs::CommandBuffer &buffer, void *)
+{
+    buffer.insert_resource(LastWriter{'h'});
+}
+
+static void sys_after_waiting(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+}
+
+Test(Scheduler, SystemsRunWhileWaitingKeepTheSourceOfTheWaitingSystem)
+{
+    GraphRunner runner(1);
+    r::sys::ScheduleGraph graph;
+    const auto spawner = add_node<sys_spawner>(graph, "spawner");
+    const auto waiting = add_node<sys_waiting>(graph, "waiting", {spawner});
+    const auto helped = add_node<sys_helped>(graph, "helped", {spawner});
+
+    nesting_pool = &runner.pool;
+    add_node<sys_after_waiting>(graph, "after", {waiting});
+
+    /**
+    * the read-only waiting system is dispatched before the helped one, and ranks higher through its
+    * successor: the single worker runs it first, then runs the helped system while waiting on the nested task
+    */
+    graph.nodes.at(helped).resource_access.writes.insert(typeid(SharedCounter));
+
+    runner.run(graph);
+    r::ecs::CommandBuffer::apply_merged(runner.scene, runner.main_buffer, runner.buffers);
+    cr_assert_eq(runner.scene.get_resource_ptr<LastWriter>()->system, 'h',
+        "the command recorded after the wait keeps the earlier source of the waiting system");
+}
+
+static void sys_whole_scene(r::ecs::Scene &scene)
+{
+    (void) scene;
+}
+
+static void sys_no_access(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+}
+
+Test(Scheduler, SceneParametersAreOrderedAgainstEverySystem)
+{
+    GraphRunner runner(2);
+    r::sys::ScheduleGraph graph;
+    const auto exclusive = add_node<sys_whole_scene>(graph, "exclusive", {}, sys_no_access);
+
+    add_node<sys_no_access>(graph, "other");
+    graph.nodes.at(exclusive).is_main_thread_only = true;
+    r::ecs::get_system_access<sys_whole_scene>(graph.nodes.at(exclusive).component_access, graph.nodes.at(exclusive).resource_access);
+
+    /* a system declaring no access would otherwise run next to the main thread one */
+    runner.run(graph);
+    cr_assert_eq(graph.dag.size(), 2u);
+    cr_assert_eq(graph.dag[0].predecessors + graph.dag[1].predecessors, 1u, "the Scene & system is ordered against the other one");
+}
+
+static std::vector<char> run_order;
+
+static void sys_heavy(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    run_order.push_back('h');
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+static void sys_light(r::ecs::Scene &, r::ecs::CommandBuffer &, void *)
+{
+    run_order.push_back('l');
+}
+
+Test(Scheduler, MeasuredRunTimesRankTheLongestPathFirst)
+{
+    /* a single worker runs the roots one after the other, in the order they are dispatched */
+    GraphRunner runner(1);
+    r::sys::ScheduleGraph graph;
+    const auto heavy = add_node<sys_heavy>(graph, "heavy");
+    const auto light = add_node<sys_light>(graph, "light");
+
+    /* the first run ranks on path length only, the measured times kick in once the graph is re-sorted */
+    runner.run(graph);
+    cr_assert_gt(runner.scheduler.get_average_run_time(heavy), runner.scheduler.get_average_run_time(light));
+
+    graph.dirty = true;
+    run_order.clear();
+    runner.run(graph);
+
+    const auto &heavy_system = graph.dag[0].node->id == heavy ? graph.dag[0] : graph.dag[1];
+    const auto &light_system = graph.dag[0].node->id == heavy ? graph.dag[1] : graph.dag[0];
+
+    cr_assert_gt(heavy_system.rank, light_system.rank);
+    cr_assert(run_order == (std::vector<char>{'h', 'l'}), "the system heading the longest path is dispatched first");
+}
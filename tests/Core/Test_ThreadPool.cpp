@@ -0,0 +1,62 @@
+#include "../Test.hpp"
+
+#include <R-Engine/Core/ThreadPool.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+Test(ThreadPool, TaskHandlesReturnResultsAndExceptions)
+{
+    r::core::ThreadPool pool(4);
+
+    auto sum = pool.enqueue([](int a, int b) { return a + b; }, 2, 40);
+    auto failing = pool.enqueue([] { throw std::runtime_error("boom"); });
+
+    cr_assert_eq(sum.get(), 42);
+    cr_assert_not(sum.valid(), "get() empties the handle");
+    try {
+        failing.get();
+        cr_assert_fail("The exception of the task is rethrown by get()");
+    } catch (const std::runtime_error &e) {
+        cr_assert_str_eq(e.what(), "boom");
+    }
+}
+
+Test(ThreadPool, NestedTasksDoNotStarveThePool)
+{
+    /* every worker waits on tasks it enqueued itself, which only completes if waiting workers help */
+    r::core::ThreadPool pool(2);
+    std::atomic<int> leaves{0};
+    std::vector<r::core::TaskHandle<void>> roots;
+
+    for (int i = 0; i < 8; ++i) {
+        roots.push_back(pool.enqueue([&pool, &leaves] {
+            std::vector<r::core::TaskHandle<void>> children;
+
+            for (int j = 0; j < 16; ++j) {
+                children.push_back(pool.enqueue([&leaves] { leaves.fetch_add(1, std::memory_order_relaxed); }));
+            }
+            for (auto &child : children) {
+                child.wait();
+            }
+        }));
+    }
+    for (auto &root : roots) {
+        root.get();
+    }
+    cr_assert_eq(leaves.load(), 8 * 16);
+}
+
+Test(ThreadPool, PoolWithoutWorkersRunsInline)
+{
+    r::core::ThreadPool pool(0);
+    int counter = 0;
+
+    auto task = pool.enqueue([&counter] { return ++counter; });
+
+    cr_assert(task.is_ready());
+    cr_assert_eq(task.get(), 1);
+    pool.parallel_for(10, [&counter](size_t) { ++counter; });
+    cr_assert_eq(counter, 11);
+}
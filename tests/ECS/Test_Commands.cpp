@@ -1,8 +1,13 @@
 #include "../Test.hpp"
 
+#include "R-Engine/Core/Error.hpp"
 #include "R-Engine/ECS/Command.hpp"
 #include "R-Engine/ECS/Scene.hpp"
 
+#include <algorithm>
+#include <string>
+#include <thread>
+
 struct TestPosition {
         f32 x = 0;
         f32 y = 0;
@@ -17,41 +22,36 @@ struct TestVelocity {
 Test(Commands, CommandSpawn)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto commands = r::ecs::Commands(buffer.get());
 
-    // Spawning returns an EntityCommands handle with a placeholder ID.
+    // Spawning returns an EntityCommands handle with an ID reserved in the scene.
     auto entity_cmd = commands.spawn();
-    const auto placeholder_entity = entity_cmd.id();
+    const auto entity = entity_cmd.id();
 
-    // The entity does not exist in the scene yet.
-    cr_assert(placeholder_entity != 0, "Placeholder entity should not be 0.");
+    cr_assert(entity == 1, "The first reserved entity ID should be 1.");
+    cr_assert(!scene->is_alive(entity), "The entity does not exist in the scene yet.");
 
     buffer->apply(*scene);
 
-    // The placeholder map in the scene should now map the placeholder to a real entity.
-    const auto &placeholder_map = scene->get_command_buffer_placeholder_map();
-    cr_assert(placeholder_map.count(placeholder_entity) > 0, "Placeholder should be mapped to a real entity after apply.");
-    const auto real_entity = placeholder_map.at(placeholder_entity);
-    cr_assert(real_entity == 1, "The first real entity ID should be 1.");
+    cr_assert(scene->is_alive(entity), "The reserved entity should be alive after apply.");
 }
 
 Test(Commands, CommandAddComponent)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto commands = r::ecs::Commands(buffer.get());
 
     // Use the new bundle spawn syntax for single components.
-    const auto placeholder_entity = commands.spawn(TestPosition{1.0f, 2.0f, 3.0f}).id();
+    const auto real_entity = commands.spawn(TestPosition{1.0f, 2.0f, 3.0f}).id();
 
     // Before applying, the component does not exist.
-    cr_assert(scene->has_component<TestPosition>(1) == false, "Component should not exist before applying buffer.");
+    cr_assert(scene->has_component<TestPosition>(real_entity) == false, "Component should not exist before applying buffer.");
 
     buffer->apply(*scene);
 
-    // After applying, the component should exist on the real entity.
-    const auto real_entity = scene->get_command_buffer_placeholder_map().at(placeholder_entity);
+    // After applying, the component should exist on the entity.
     cr_assert(scene->has_component<TestPosition>(real_entity) == true, "Component should exist after applying buffer.");
     cr_assert(scene->get_component_ptr<TestPosition>(real_entity)->x == 1.0f);
     cr_assert(scene->get_component_ptr<TestPosition>(real_entity)->y == 2.0f);
@@ -61,15 +61,14 @@ Test(Commands, CommandAddComponent)
 Test(Commands, CommandBundleSpawn)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto commands = r::ecs::Commands(buffer.get());
 
     // Spawn an entity with a bundle of components.
-    const auto placeholder_entity = commands.spawn(TestPosition{10.f, 20.f, 30.f}, TestVelocity{1.f, 2.f}).id();
+    const auto real_entity = commands.spawn(TestPosition{10.f, 20.f, 30.f}, TestVelocity{1.f, 2.f}).id();
 
     buffer->apply(*scene);
 
-    const auto real_entity = scene->get_command_buffer_placeholder_map().at(placeholder_entity);
     cr_assert(scene->has_component<TestPosition>(real_entity), "Position component should exist after bundle spawn.");
     cr_assert(scene->has_component<TestVelocity>(real_entity), "Velocity component should exist after bundle spawn.");
 
@@ -82,7 +81,7 @@ Test(Commands, CommandBundleSpawn)
 Test(Commands, CommandDespawn)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
 
     // First, create an entity directly in the scene to test despawning it.
     const auto entity_to_despawn = scene->create_entity();
@@ -119,3 +118,195 @@ Test(Commands, CommandAddComponentNoBuffer)
     entity_cmd.insert(TestPosition{1.0f, 2.0f, 3.0f});
     cr_assert(true);
 }
+
+Test(Commands, SpawnBundleSkipsIntermediateArchetypes)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto commands = r::ecs::Commands(buffer.get());
+
+    const auto real_entity = commands.spawn(TestPosition{1.0f, 2.0f, 3.0f}, TestVelocity{4.0f, 5.0f}).id();
+    buffer->apply(*scene);
+
+    // Only the empty archetype and the [Position, Velocity] archetype should exist.
+    cr_assert_eq(scene->get_archetypes().size(), 2u, "Bundle spawn should not create intermediate archetypes.");
+
+    cr_assert(scene->get_component_ptr<TestPosition>(real_entity)->z == 3.0f);
+    cr_assert(scene->get_component_ptr<TestVelocity>(real_entity)->vy == 5.0f);
+}
+
+Test(Commands, SpawnBatch)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto commands = r::ecs::Commands(buffer.get());
+
+    std::vector<std::tuple<TestPosition, TestVelocity>> bundles;
+    for (int i = 0; i < 100; ++i) {
+        bundles.emplace_back(TestPosition{static_cast<f32>(i), 0.0f, 0.0f}, TestVelocity{0.0f, static_cast<f32>(i)});
+    }
+    commands.spawn_batch(std::move(bundles));
+    buffer->apply(*scene);
+
+    cr_assert_eq(scene->get_archetypes().size(), 2u);
+
+    const auto &table = scene->get_archetypes()[1].table;
+    cr_assert_eq(table.entities.size(), 100u, "All bundles should land in the same archetype.");
+    for (usize row = 0; row < table.entities.size(); ++row) {
+        const auto e = table.entities[row];
+        cr_assert(scene->get_component_ptr<TestPosition>(e)->x == scene->get_component_ptr<TestVelocity>(e)->vy);
+    }
+}
+
+struct TestName {
+        std::string value;
+};
+
+Test(Commands, ArenaSpansBlocksAndIsReused)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto commands = r::ecs::Commands(buffer.get());
+
+    /* enough records to fill several arena blocks, with payloads that own heap memory */
+    for (int frame = 0; frame < 2; ++frame) {
+        for (int i = 0; i < 2000; ++i) {
+            commands.spawn().insert(TestName{std::string(64, static_cast<char>('a' + frame))}).insert(TestPosition{static_cast<f32>(i)});
+        }
+        buffer->apply(*scene);
+    }
+
+    int count = 0;
+    for (const auto &archetype : scene->get_archetypes()) {
+        count += static_cast<int>(archetype.table.entities.size());
+    }
+    cr_assert_eq(count, 4000);
+    cr_assert_eq(scene->get_component_ptr<TestName>(1)->value, std::string(64, 'a'));
+
+    /* pending payloads are destroyed with the buffer */
+    commands.spawn().insert(TestName{"never applied"});
+}
+
+struct TestTurn {
+        int value = 0;
+};
+
+Test(Commands, MergedBuffersApplyInSourceOrder)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    r::ecs::CommandBuffer main(scene.get());
+    std::vector<std::unique_ptr<r::ecs::CommandBuffer>> others;
+    others.push_back(std::make_unique<r::ecs::CommandBuffer>(scene.get()));
+
+    /* the main buffer ran the later system, its commands must still come last */
+    main.set_source(2);
+    main.insert_resource(TestTurn{2});
+    const auto a = main.spawn_bundle(TestPosition{1.0f});
+    const auto b = main.spawn_bundle(TestPosition{1.5f});
+    main.despawn(a);
+    others[0]->set_source(1);
+    others[0]->insert_resource(TestTurn{1});
+
+    r::ecs::CommandBuffer::apply_merged(*scene, main, others);
+
+    cr_assert_eq(scene->get_resource_ptr<TestTurn>()->value, 2, "Commands of the earlier source are applied first");
+    cr_assert(!scene->is_alive(a));
+    cr_assert_eq(scene->get_component_ptr<TestPosition>(b)->x, 1.5f);
+}
+
+Test(Commands, ReservedIdsAreSharedAcrossBuffers)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    r::ecs::CommandBuffer main(scene.get());
+    std::vector<std::unique_ptr<r::ecs::CommandBuffer>> others;
+    others.push_back(std::make_unique<r::ecs::CommandBuffer>(scene.get()));
+
+    main.set_source(1);
+    const auto parent = main.spawn_bundle(TestPosition{1.0f});
+    others[0]->set_source(2);
+    const auto child = others[0]->spawn_bundle(TestVelocity{2.0f});
+    others[0]->add_component(parent, TestVelocity{3.0f});
+    others[0]->add_child(parent, child);
+
+    cr_assert_neq(parent, child, "Every buffer reserves distinct IDs from the scene");
+    r::ecs::CommandBuffer::apply_merged(*scene, main, others);
+
+    cr_assert_eq(scene->get_component_ptr<TestVelocity>(parent)->vx, 3.0f);
+    cr_assert_eq(scene->get_component_ptr<r::ecs::Children>(parent)->entities[0], child);
+}
+
+Test(Commands, ConsecutiveSpawnsKeepTheirIds)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto commands = r::ecs::Commands(buffer.get());
+    std::vector<r::ecs::Entity> entities;
+
+    /* long enough to be applied as one batch, followed by a shorter run applied one by one */
+    for (int i = 0; i < 40; ++i) {
+        entities.push_back(commands.spawn(TestPosition{static_cast<f32>(i)}).id());
+    }
+    for (int i = 40; i < 43; ++i) {
+        entities.push_back(commands.spawn(TestPosition{static_cast<f32>(i)}, TestVelocity{}).id());
+    }
+    buffer->apply(*scene);
+
+    for (usize i = 0; i < entities.size(); ++i) {
+        cr_assert_eq(scene->get_component_ptr<TestPosition>(entities[i])->x, static_cast<f32>(i));
+    }
+}
+
+Test(Commands, SpawnReportsErrorsToTheCaller)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    r::ecs::CommandBuffer unbound(nullptr);
+    r::ecs::CommandBuffer buffer(scene.get());
+    auto commands = r::ecs::Commands(&buffer);
+    bool unbound_threw = false;
+    bool exhausted_threw = false;
+
+    try {
+        r::ecs::Commands(&unbound).spawn(TestPosition{});
+    } catch (const r::exception::Error &) {
+        unbound_threw = true;
+    }
+    cr_assert(unbound_threw, "A buffer without a scene cannot reserve an ID");
+
+    try {
+        for (u32 i = 0; i <= r::ecs::ENTITY_INDEX_MASK; ++i) {
+            scene->reserve_entity();
+        }
+    } catch (const r::exception::Error &) {
+    }
+    try {
+        commands.spawn().with_children([](r::ecs::ChildBuilder &child) { child.spawn(TestPosition{}); });
+    } catch (const r::exception::Error &) {
+        exhausted_threw = true;
+    }
+    cr_assert(exhausted_threw, "Running out of entity indices is reported, not fatal");
+}
+
+Test(Scene, ReserveEntitiesConcurrently)
+{
+    r::ecs::Scene scene;
+    std::vector<r::ecs::Entity> reserved(4 * 1000);
+    std::vector<std::thread> threads;
+
+    for (usize t = 0; t < 4; ++t) {
+        threads.emplace_back([&scene, &reserved, t] {
+            for (usize i = 0; i < 1000; ++i) {
+                reserved[t * 1000 + i] = scene.reserve_entity();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::sort(reserved.begin(), reserved.end());
+    cr_assert(std::adjacent_find(reserved.begin(), reserved.end()) == reserved.end(), "Reserved IDs must be unique");
+    for (const auto e : reserved) {
+        scene.spawn_reserved(e, TestPosition{});
+    }
+    cr_assert_eq(scene.get_archetypes()[1].table.entities.size(), 4000u);
+}
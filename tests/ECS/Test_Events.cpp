@@ -0,0 +1,230 @@
+#include "../Test.hpp"
+
+#include "R-Engine/Core/ThreadPool.hpp"
+#include "R-Engine/ECS/Command.hpp"
+#include "R-Engine/ECS/Event.hpp"
+#include "R-Engine/ECS/Resolver.hpp"
+#include "R-Engine/ECS/Scene.hpp"
+#include "R-Engine/ECS/System.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+struct Hit {
+        int source = 0;
+        int seq = 0;
+};
+
+Test(Events, EventsAreReadableAfterOneUpdate)
+{
+    r::ecs::Events<Hit> events;
+    r::ecs::EventWriter<Hit> writer(&events);
+    r::ecs::EventReader<Hit> reader(&events);
+
+    writer.send(Hit{0, 1});
+    cr_assert_not(reader.has_events(), "Events are only readable after the next update");
+
+    events.update();
+    cr_assert(reader.has_events());
+    cr_assert_eq(reader.begin()->seq, 1);
+
+    events.update();
+    cr_assert_not(reader.has_events(), "Events are dropped after one update");
+}
+
+Test(Events, ConcurrentWritersAreMerged)
+{
+    r::ecs::Events<Hit> events;
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&events, t] {
+            r::ecs::EventWriter<Hit> writer(&events);
+
+            for (int i = 0; i < 1000; ++i) {
+                writer.send(Hit{t, i});
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    events.update();
+
+    std::vector<int> last(8, -1);
+    usize count = 0;
+    for (const Hit &hit : r::ecs::EventReader<Hit>(&events)) {
+        cr_assert_gt(hit.seq, last[static_cast<usize>(hit.source)], "Events of a thread keep their order");
+        last[static_cast<usize>(hit.source)] = hit.seq;
+        ++count;
+    }
+    cr_assert_eq(count, 8000u);
+}
+
+Test(Events, EventsAreMergedBySendingSource)
+{
+    r::ecs::Events<Hit> events;
+    std::vector<std::thread> threads;
+
+    /* the thread sending the later source starts first, the merge must not depend on it */
+    for (int t = 3; t >= 0; --t) {
+        threads.emplace_back([&events, t] {
+            r::ecs::EventWriter<Hit> writer(&events, static_cast<u64>(t));
+
+            for (int i = 0; i < 10; ++i) {
+                writer.send(Hit{t, i});
+            }
+        });
+        threads.back().join();
+    }
+    events.update();
+
+    int expected = 0;
+    for (const Hit &hit : r::ecs::EventReader<Hit>(&events)) {
+        cr_assert_eq(hit.source * 10 + hit.seq, expected++, "Events are ordered by source, then by sending order");
+    }
+    cr_assert_eq(expected, 40);
+}
+
+Test(Events, SystemWritersUseTheSourceOfTheirBuffer)
+{
+    r::ecs::Scene scene;
+    r::ecs::CommandBuffer first(&scene);
+    r::ecs::CommandBuffer second(&scene);
+
+    scene.insert_resource(r::ecs::Events<Hit>{});
+    first.set_source(7);
+    second.set_source(3);
+
+    r::ecs::Resolver(&scene, &first).resolve(std::type_identity<r::ecs::EventWriter<Hit>>{}).send(Hit{7, 0});
+    r::ecs::Resolver(&scene, &second).resolve(std::type_identity<r::ecs::EventWriter<Hit>>{}).send(Hit{3, 0});
+
+    auto *events = scene.get_resource_ptr<r::ecs::Events<Hit>>();
+    events->update();
+
+    std::vector<int> sources;
+    for (const Hit &hit : r::ecs::EventReader<Hit>(events)) {
+        sources.push_back(hit.source);
+    }
+    cr_assert(sources == (std::vector<int>{3, 7}));
+}
+
+struct HitRow {
+        int value = 0;
+};
+
+Test(Events, ParallelRowsSendInRowOrder)
+{
+    r::ecs::Scene scene;
+    r::ecs::CommandBuffer buffer(&scene);
+    r::core::ThreadPool pool(4);
+    constexpr int rows = 512;
+
+    scene.set_thread_pool(&pool);
+    scene.insert_resource(r::ecs::Events<Hit>{});
+    for (int i = 0; i < rows; ++i) {
+        r::ecs::Commands(&buffer).spawn(HitRow{i});
+    }
+    buffer.apply(scene);
+    buffer.set_source(5);
+
+    r::ecs::Resolver resolver(&scene, &buffer);
+    auto writer = resolver.resolve(std::type_identity<r::ecs::EventWriter<Hit>>{});
+    auto query = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<HitRow>>>{});
+
+    /* one writer shared by every worker, each batch of rows lands in whichever segment its worker maps to */
+    writer.send(Hit{5, -1});
+    query.par_for_each(8, [&writer](r::ecs::Ref<HitRow> row) {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        writer.send(Hit{5, row.ptr->value});
+    });
+    writer.send(Hit{5, rows});
+
+    auto *events = scene.get_resource_ptr<r::ecs::Events<Hit>>();
+    events->update();
+
+    int expected = -1;
+    for (const Hit &hit : r::ecs::EventReader<Hit>(events)) {
+        cr_assert_eq(hit.seq, expected++, "Events of one source keep the row order of par_for_each");
+    }
+    cr_assert_eq(expected, rows + 1);
+}
+
+static void send_hits(r::ecs::EventWriter<Hit> writer)
+{
+    writer.send(Hit{});
+}
+
+static void read_hits(r::ecs::EventReader<Hit> reader)
+{
+    (void) reader;
+}
+
+Test(Events, WritersAndReadersShareAccess)
+{
+    r::sys::Access writer_comp, writer_res, reader_comp, reader_res;
+
+    r::ecs::get_system_access<send_hits>(writer_comp, writer_res);
+    r::ecs::get_system_access<read_hits>(reader_comp, reader_res);
+
+    cr_assert_eq(writer_res.reads.count(typeid(r::ecs::Events<Hit>)), 1u);
+    cr_assert_eq(reader_res.reads.count(typeid(r::ecs::Events<Hit>)), 1u);
+    cr_assert(writer_res.writes.empty(), "Writers do not need exclusive access");
+}
+
+static usize count_events(const r::ecs::EventReader<Hit> &reader)
+{
+    usize count = 0;
+
+    for (auto it = reader.begin(); it != reader.end(); ++it) {
+        ++count;
+    }
+    return count;
+}
+
+Test(Events, CursorsKeepEventsUntilEveryReaderConsumedThem)
+{
+    r::ecs::Scene scene;
+    r::ecs::CommandBuffer buffer(&scene);
+    r::ecs::Resolver resolver(&scene, &buffer);
+    r::ecs::EventCursor fast, slow;
+
+    scene.insert_resource(r::ecs::Events<Hit>{});
+    auto *events = scene.get_resource_ptr<r::ecs::Events<Hit>>();
+
+    (void) resolver.resolve(std::type_identity<r::ecs::EventReader<Hit>>{}, fast);
+    (void) resolver.resolve(std::type_identity<r::ecs::EventReader<Hit>>{}, slow);
+
+    events->send(Hit{0, 1});
+    events->update();
+    cr_assert_eq(count_events(resolver.resolve(std::type_identity<r::ecs::EventReader<Hit>>{}, fast)), 1u);
+    cr_assert_eq(count_events(resolver.resolve(std::type_identity<r::ecs::EventReader<Hit>>{}, fast)), 0u, "A reader never sees an event twice");
+
+    events->send(Hit{0, 2});
+    events->update();
+    events->update();
+    cr_assert_eq(count_events(resolver.resolve(std::type_identity<r::ecs::EventReader<Hit>>{}, fast)), 1u);
+    cr_assert_eq(count_events(resolver.resolve(std::type_identity<r::ecs::EventReader<Hit>>{}, slow)), 2u,
+        "Events are kept for a reader that did not run");
+    cr_assert_eq(events->first_id(), 0u);
+
+    events->update();
+    cr_assert_eq(events->first_id(), events->end_id(), "Events consumed by every reader are dropped");
+}
+
+Test(Events, RetentionDropsEventsOfStalledReaders)
+{
+    r::ecs::Events<Hit> events(2);
+    u64 *stalled = events.register_reader();
+
+    events.send(Hit{0, 1});
+    events.update();
+    events.send(Hit{0, 2});
+    events.update();
+    cr_assert_eq(events.end_id() - events.first_id(), 2u);
+
+    events.update();
+    cr_assert_eq(events.first_id(), 1u, "Events older than the retention are dropped");
+    cr_assert_eq(r::ecs::EventReader<Hit>(&events, (std::max)(*stalled, events.first_id()), events.end_id()).begin()->seq, 2);
+}
@@ -1,9 +1,12 @@
 #include "../Test.hpp"
 
+#include "R-Engine/Core/ThreadPool.hpp"
 #include "R-Engine/ECS/Command.hpp"
 #include "R-Engine/ECS/Resolver.hpp"
 #include "R-Engine/ECS/Scene.hpp"
 
+#include <atomic>
+
 struct FrameTime {
         float delta_time = 0.0f;
 };
@@ -27,7 +30,7 @@ struct PlayerTag {
 Test(Resolver, ResolveRes)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     scene->insert_resource<FrameTime>(FrameTime{0.25f});
 
     r::ecs::Resolver resolver(scene.get(), buffer.get());
@@ -37,27 +40,64 @@ Test(Resolver, ResolveRes)
     cr_assert_eq(res.ptr->delta_time, 0.25f);
 }
 
+Test(Resolver, ResourcesKeepTheirAddress)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    scene->insert_resource(Health{7});
+    const Health *health = scene->get_resource_ptr<Health>();
+
+    scene->insert_resource(FrameTime{0.5f});
+    scene->insert_resource(Position{1.0f, 2.0f});
+    cr_assert_eq(scene->get_resource_ptr<Health>(), health, "Inserting other resources does not move a resource");
+    cr_assert_eq(health->value, 7);
+
+    scene->remove_resource<FrameTime>();
+    cr_assert_null(scene->get_resource_ptr<FrameTime>());
+    cr_assert_null(scene->get_resource_ptr<Velocity>());
+    cr_assert_eq(scene->get_resource_ptr<Health>(), health);
+}
+
+Test(Resolver, CachedResourceFollowsTheScene)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    r::ecs::Resolver resolver(scene.get(), buffer.get());
+    r::ecs::ResourceState state;
+
+    cr_assert_null(resolver.resolve(std::type_identity<r::ecs::Res<FrameTime>>{}, state).ptr);
+
+    scene->insert_resource(FrameTime{0.5f});
+    cr_assert_eq(resolver.resolve(std::type_identity<r::ecs::Res<FrameTime>>{}, state).ptr->delta_time, 0.5f);
+
+    scene->insert_resource(FrameTime{1.5f});
+    cr_assert_eq(resolver.resolve(std::type_identity<r::ecs::Res<FrameTime>>{}, state).ptr->delta_time, 1.5f,
+        "A replaced resource is looked up again");
+
+    scene->remove_resource<FrameTime>();
+    cr_assert_null(resolver.resolve(std::type_identity<r::ecs::Res<FrameTime>>{}, state).ptr);
+}
+
 Test(Resolver, ResolveCommands)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     r::ecs::Resolver resolver(scene.get(), buffer.get());
 
     auto cmds = resolver.resolve(std::type_identity<r::ecs::Commands>{});
-    const auto placeholder_entity = cmds.spawn().id();
+    const auto entity = cmds.spawn().id();
 
-    cr_assert(placeholder_entity != 0);
-    // The entity doesn't exist yet, so we can't check its components in the scene.
-    // Applying the buffer would make it exist.
+    cr_assert(entity != 0);
+    // The entity is only reserved, applying the buffer makes it exist.
+    cr_assert(!scene->is_alive(entity));
     buffer->apply(*scene);
-    const auto real_entity = scene->get_command_buffer_placeholder_map().at(placeholder_entity);
-    cr_assert(scene->has_component<Position>(real_entity) == false);
+    cr_assert(scene->is_alive(entity));
+    cr_assert(scene->has_component<Position>(entity) == false);
 }
 
 Test(Resolver, ResolveQuerySingleEntity)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto cmds = r::ecs::Commands(buffer.get());
 
     cmds.spawn(Position{1.0f, 2.0f});
@@ -78,7 +118,7 @@ Test(Resolver, ResolveQuerySingleEntity)
 Test(Resolver, ResolveQueryMultipleEntities)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto cmds = r::ecs::Commands(buffer.get());
 
     cmds.spawn(Position{1.0f, 1.0f}, Velocity{0.5f, 0.5f});
@@ -105,7 +145,7 @@ Test(Resolver, ResolveQueryMultipleEntities)
 Test(Resolver, ResolveQueryEmpty)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     r::ecs::Resolver resolver(scene.get(), buffer.get());
 
     auto query = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>>>{});
@@ -120,7 +160,7 @@ Test(Resolver, ResolveQueryEmpty)
 Test(Resolver, CombinedResAndQuery)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     scene->insert_resource<FrameTime>(FrameTime{1.0f});
 
     auto cmds = r::ecs::Commands(buffer.get());
@@ -144,7 +184,7 @@ Test(Resolver, CombinedResAndQuery)
 Test(Resolver, ResolveUnsupportedType)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     r::ecs::Resolver resolver(scene.get(), buffer.get());
     // This test doesn't do anything, but it shouldn't fail to compile.
     // A static_assert would trigger a compile-time error.
@@ -154,7 +194,7 @@ Test(Resolver, ResolveUnsupportedType)
 Test(Resolver, ResolveQueryWithFilter)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto cmds = r::ecs::Commands(buffer.get());
 
     cmds.spawn(Position{10, 10}, PlayerTag{});
@@ -175,7 +215,7 @@ Test(Resolver, ResolveQueryWithFilter)
 Test(Resolver, ResolveQueryWithoutFilter)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto cmds = r::ecs::Commands(buffer.get());
 
     cmds.spawn(Position{10, 10}, Velocity{1, 1});
@@ -196,7 +236,7 @@ Test(Resolver, ResolveQueryWithoutFilter)
 Test(Resolver, ResolveQueryOptionalFilter)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto cmds = r::ecs::Commands(buffer.get());
 
     cmds.spawn(Position{10, 10}, Health{80});
@@ -228,7 +268,7 @@ Test(Resolver, ResolveQueryOptionalFilter)
 Test(Resolver, ResolveQueryCombinedFilters)
 {
     auto scene = std::make_unique<r::ecs::Scene>();
-    auto buffer = std::make_unique<r::ecs::CommandBuffer>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
     auto cmds = r::ecs::Commands(buffer.get());
 
     // e1: Player with Position but no Velocity (should be found)
@@ -250,3 +290,240 @@ Test(Resolver, ResolveQueryCombinedFilters)
     }
     cr_assert_eq(count, 1, "Expected to find exactly one entity");
 }
+
+Test(Resolver, ResolveQuerySpansArchetypes)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto cmds = r::ecs::Commands(buffer.get());
+
+    // Three archetypes all containing Position: [Position], [Position, Velocity], [Position, Health]
+    cmds.spawn(Position{1, 0});
+    cmds.spawn(Position{2, 0}, Velocity{1, 1});
+    cmds.spawn(Position{3, 0}, Health{50});
+    cmds.spawn(Position{4, 0});
+    buffer->apply(*scene);
+
+    r::ecs::Resolver resolver(scene.get(), buffer.get());
+    auto query = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>>>{});
+
+    cr_assert_eq(query.size(), 4u);
+
+    float sum = 0.0f;
+    int count = 0;
+    for (auto it = query.begin(); it != query.end(); ++it) {
+        auto [pos] = *it;
+        cr_assert_eq(scene->get_component_ptr<Position>(it.entity()), pos.ptr, "Iterator entity should own the yielded component");
+        sum += pos.ptr->x;
+        ++count;
+    }
+    cr_assert_eq(count, 4);
+    cr_assert_eq(sum, 10.0f);
+}
+
+Test(Resolver, QueryIterationSkipsEmptiedArchetypes)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    using Q = r::ecs::Query<r::ecs::Ref<Position>>;
+
+    const r::ecs::Entity moved = scene->create_entity();
+    scene->add_component(moved, Position{1, 0});
+    scene->add_component(moved, Velocity{});
+    const r::ecs::Entity other = scene->create_entity();
+    scene->add_component(other, Position{2, 0});
+    scene->add_component(other, Health{});
+
+    /* a query built before the move still holds the chunk of the emptied [Position] archetype */
+    std::vector<Q::Chunk> chunks;
+    for (const auto &archetype : scene->get_archetypes()) {
+        if (archetype.has_component(r::ecs::component_id<Position>())) {
+            chunks.push_back(Q::make_chunk(archetype));
+        }
+    }
+    const Q query(scene.get(), std::move(chunks));
+
+    int count = 0;
+    float sum = 0.0f;
+    for (auto &&[pos] : query) {
+        sum += pos.ptr->x;
+        ++count;
+    }
+    cr_assert_eq(count, 2);
+    cr_assert_eq(sum, 3.0f);
+}
+
+Test(Resolver, ResolveQueryForEach)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto cmds = r::ecs::Commands(buffer.get());
+
+    cmds.spawn(Position{1.0f, 1.0f}, Velocity{0.5f, 0.5f});
+    cmds.spawn(Position{2.0f, 2.0f}, Velocity{1.5f, 1.5f}, Health{10});
+    buffer->apply(*scene);
+
+    r::ecs::Resolver resolver(scene.get(), buffer.get());
+    auto query = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Mut<Position>, r::ecs::Ref<Velocity>>>{});
+
+    query.for_each([](r::ecs::Mut<Position> pos, r::ecs::Ref<Velocity> vel) {
+        pos.ptr->x += vel.ptr->vx;
+        pos.ptr->y += vel.ptr->vy;
+    });
+
+    cr_assert_eq(scene->get_component_ptr<Position>(1)->x, 1.5f);
+    cr_assert_eq(scene->get_component_ptr<Position>(2)->x, 3.5f);
+}
+
+Test(Resolver, ResolveQueryParallelForEach)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto cmds = r::ecs::Commands(buffer.get());
+    r::core::ThreadPool pool(4);
+
+    scene->set_thread_pool(&pool);
+    for (int i = 0; i < 1000; ++i) {
+        cmds.spawn(Position{static_cast<float>(i), 0.0f}, Velocity{1.0f, 2.0f});
+        if (i % 2 == 0) {
+            cmds.spawn(Position{static_cast<float>(i), 0.0f}, Velocity{1.0f, 2.0f}, Health{i});
+        }
+    }
+    buffer->apply(*scene);
+
+    r::ecs::Resolver resolver(scene.get(), buffer.get());
+    auto query = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Mut<Position>, r::ecs::Ref<Velocity>>>{});
+    std::atomic<int> visited{0};
+
+    query.par_for_each(64, [&visited](r::ecs::Mut<Position> pos, r::ecs::Ref<Velocity> vel) {
+        pos.ptr->y += vel.ptr->vy;
+        visited.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    cr_assert_eq(visited.load(), 1500, "Every matched entity should be visited exactly once.");
+    for (const auto &[pos, vel] : query) {
+        cr_assert_eq(pos.ptr->y, 2.0f);
+    }
+}
+
+Test(Resolver, ResolveQueryWithCachedState)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto cmds = r::ecs::Commands(buffer.get());
+    r::ecs::QueryState state;
+
+    cmds.spawn(Position{1, 0});
+    buffer->apply(*scene);
+
+    r::ecs::Resolver resolver(scene.get(), buffer.get());
+    auto first = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>>>{}, state);
+    cr_assert_eq(first.size(), 1u);
+    cr_assert_eq(state.archetype_generation, scene->get_archetype_generation());
+    const auto matched_before = state.matched_archetypes.size();
+
+    // A new archetype containing Position is created after the state was cached.
+    cmds.spawn(Position{2, 0}, Velocity{1, 1});
+    buffer->apply(*scene);
+    cr_assert_neq(state.archetype_generation, scene->get_archetype_generation());
+
+    auto second = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>>>{}, state);
+    cr_assert_eq(second.size(), 2u, "Archetypes created since the last run should be matched");
+    cr_assert_eq(state.matched_archetypes.size(), matched_before + 1);
+    cr_assert_eq(state.archetype_generation, scene->get_archetype_generation());
+}
+
+Test(Resolver, ResolveQueryAddedAndChangedFilters)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    auto cmds = r::ecs::Commands(buffer.get());
+
+    cmds.spawn(Position{1.0f, 0.0f}, Velocity{1.0f, 0.0f});
+    cmds.spawn(Position{2.0f, 0.0f}, Velocity{1.0f, 0.0f});
+    buffer->apply(*scene);
+
+    /* first run of a system: everything counts as added */
+    u32 last_run = 0;
+    u32 this_run = scene->increment_change_tick();
+    {
+        r::ecs::Resolver resolver(scene.get(), buffer.get(), last_run, this_run);
+        auto added = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::Added<Position>>>{});
+        cr_assert_eq(added.size(), 2u);
+    }
+
+    /* a writer touches the first entity only */
+    {
+        r::ecs::Resolver writer(scene.get(), buffer.get());
+        auto query = writer.resolve(std::type_identity<r::ecs::Query<r::ecs::Mut<Position>, r::ecs::Ref<Velocity>>>{});
+        for (auto it = query.begin(); it != query.end(); ++it) {
+            if (scene->get_component_ptr<Position>(it.entity())->x == 1.0f) {
+                auto [pos, vel] = *it;
+                pos.ptr->x += vel.ptr->vx;
+            }
+        }
+    }
+
+    /* second run: nothing new was added, one row changed */
+    last_run = this_run;
+    this_run = scene->increment_change_tick();
+    {
+        r::ecs::Resolver resolver(scene.get(), buffer.get(), last_run, this_run);
+        auto added = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::Added<Position>>>{});
+        auto changed = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::Changed<Position>>>{});
+
+        cr_assert_eq(added.size(), 0u);
+        cr_assert_eq(changed.size(), 1u);
+        for (const auto &[pos, _] : changed) {
+            cr_assert_eq(pos.ptr->x, 2.0f);
+        }
+    }
+
+    /* third run: nothing happened since */
+    last_run = this_run;
+    this_run = scene->increment_change_tick();
+    {
+        r::ecs::Resolver resolver(scene.get(), buffer.get(), last_run, this_run);
+        auto changed = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::Changed<Position>>>{});
+        int visited = 0;
+
+        changed.for_each([&visited](r::ecs::Ref<Position>, r::ecs::Changed<Position>) { ++visited; });
+        cr_assert_eq(visited, 0);
+    }
+}
+
+struct Frozen {
+        static constexpr r::ecs::StorageType storage = r::ecs::StorageType::SparseSet;
+        int frames = 0;
+};
+
+Test(Resolver, ResolveQueryJoinsSparseComponents)
+{
+    auto scene = std::make_unique<r::ecs::Scene>();
+    auto buffer = std::make_unique<r::ecs::CommandBuffer>(scene.get());
+    const auto a = scene->create_entity();
+    const auto b = scene->create_entity();
+    const auto c = scene->create_entity();
+
+    scene->add_component(a, Position{1.0f, 0.0f});
+    scene->add_component(b, Position{2.0f, 0.0f});
+    scene->add_component(c, Position{3.0f, 0.0f});
+    scene->add_component(a, Frozen{5});
+    scene->add_component(c, Frozen{7});
+
+    r::ecs::Resolver resolver(scene.get(), buffer.get());
+    auto frozen = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::Mut<Frozen>>>{});
+    auto thawed = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::Without<Frozen>>>{});
+    auto tagged = resolver.resolve(std::type_identity<r::ecs::Query<r::ecs::Ref<Position>, r::ecs::With<Frozen>>>{});
+
+    cr_assert_eq(frozen.size(), 2u);
+    cr_assert_eq(thawed.size(), 1u);
+    cr_assert_eq(tagged.size(), 2u);
+
+    frozen.for_each([](r::ecs::Ref<Position> pos, r::ecs::Mut<Frozen> f) { f.ptr->frames = static_cast<int>(pos.ptr->x) * 10; });
+    cr_assert_eq(scene->get_component_ptr<Frozen>(a)->frames, 10);
+    cr_assert_eq(scene->get_component_ptr<Frozen>(c)->frames, 30);
+
+    for (const auto &[pos, _] : thawed) {
+        cr_assert_eq(pos.ptr->x, 2.0f);
+    }
+}
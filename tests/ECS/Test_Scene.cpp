@@ -0,0 +1,316 @@
+#include "../Test.hpp"
+
+#include "R-Engine/ECS/Command.hpp"
+#include "R-Engine/ECS/Query.hpp"
+#include "R-Engine/ECS/Scene.hpp"
+
+#include <random>
+#include <unordered_map>
+
+struct Health {
+        int value = 0;
+};
+
+Test(Scene, EntityHandlesPackIndexAndGeneration)
+{
+    const r::ecs::Entity e = r::ecs::make_entity(42, 3);
+
+    cr_assert_eq(r::ecs::entity_index(e), 42u);
+    cr_assert_eq(r::ecs::entity_generation(e), 3u);
+    cr_assert_gt(r::ecs::entity_generation(r::ecs::NULL_ENTITY), r::ecs::MAX_ENTITY_GENERATION,
+        "NULL_ENTITY must use the reserved generation");
+}
+
+Test(Scene, StaleHandlesAreRejected)
+{
+    r::ecs::Scene scene;
+    const auto e = scene.create_entity();
+
+    scene.add_component(e, Health{10});
+    cr_assert(scene.is_alive(e));
+    scene.destroy_entity(e);
+
+    cr_assert_not(scene.is_alive(e));
+    cr_assert_null(scene.get_entity_location(e));
+    cr_assert_null(scene.get_component_ptr<Health>(e));
+    cr_assert_not(scene.is_alive(0), "Entity 0 is reserved");
+}
+
+Test(Scene, EntityIndicesAreRecycledWithNewGeneration)
+{
+    r::ecs::Scene scene;
+    std::vector<r::ecs::Entity> destroyed;
+
+    for (int i = 0; i < 2000; ++i) {
+        destroyed.push_back(scene.create_entity());
+    }
+    for (const auto e : destroyed) {
+        scene.destroy_entity(e);
+    }
+
+    const auto reused = scene.create_entity();
+    const auto first = destroyed.front();
+
+    cr_assert_eq(r::ecs::entity_index(reused), r::ecs::entity_index(first), "Oldest free index should be reused first");
+    cr_assert_eq(r::ecs::entity_generation(reused), r::ecs::entity_generation(first) + 1);
+    cr_assert(scene.is_alive(reused));
+    cr_assert_not(scene.is_alive(first));
+
+    scene.add_component(reused, Health{5});
+    cr_assert_null(scene.get_component_ptr<Health>(first));
+    cr_assert_eq(scene.get_component_ptr<Health>(reused)->value, 5);
+}
+
+Test(Scene, SwapRemoveKeepsLocationsValid)
+{
+    r::ecs::Scene scene;
+    const auto a = scene.create_entity();
+    const auto b = scene.create_entity();
+    const auto c = scene.create_entity();
+
+    scene.add_component(a, Health{1});
+    scene.add_component(b, Health{2});
+    scene.add_component(c, Health{3});
+    scene.destroy_entity(a);
+
+    cr_assert_eq(scene.get_component_ptr<Health>(b)->value, 2);
+    cr_assert_eq(scene.get_component_ptr<Health>(c)->value, 3);
+}
+
+struct Mana {
+        int value = 0;
+};
+
+Test(Scene, RemovedComponentsAreLoggedPerFrame)
+{
+    r::ecs::Scene scene;
+    const auto a = scene.create_entity();
+    const auto b = scene.create_entity();
+
+    scene.track_removed_components<Health>();
+    scene.add_component(a, Health{1});
+    scene.add_component(a, Mana{1});
+    scene.add_component(b, Health{2});
+
+    scene.remove_component<Health>(a);
+    scene.destroy_entity(b);
+
+    cr_assert(scene.get_removed_components<Health>().empty(), "Removals become readable at the next update only");
+    scene.update_removed_components();
+
+    const auto &removed = scene.get_removed_components<Health>();
+    cr_assert_eq(removed.size(), 2u);
+    cr_assert_eq(removed[0], a);
+    cr_assert_eq(removed[1], b);
+    cr_assert(scene.get_removed_components<Mana>().empty(), "Untracked types are not logged");
+
+    scene.update_removed_components();
+    cr_assert(scene.get_removed_components<Health>().empty(), "Removals are only readable for one frame");
+}
+
+struct Stunned {
+        static constexpr r::ecs::StorageType storage = r::ecs::StorageType::SparseSet;
+        int turns = 0;
+};
+
+Test(Scene, SparseComponentsDoNotMoveEntities)
+{
+    r::ecs::Scene scene;
+    const auto e = scene.create_entity();
+
+    scene.add_component(e, Health{10});
+    const auto *before = scene.get_entity_location(e);
+    const auto archetype = before->archetype_index;
+    const auto row = before->table_row;
+
+    scene.add_component(e, Stunned{3});
+    cr_assert(scene.has_component<Stunned>(e));
+    cr_assert_eq(scene.get_component_ptr<Stunned>(e)->turns, 3);
+    cr_assert_eq(scene.get_entity_location(e)->archetype_index, archetype, "Sparse components do not change the archetype");
+    cr_assert_eq(scene.get_entity_location(e)->table_row, row);
+
+    scene.remove_component<Stunned>(e);
+    cr_assert(!scene.has_component<Stunned>(e));
+    cr_assert_eq(scene.get_entity_location(e)->archetype_index, archetype);
+
+    scene.add_component(e, Stunned{1});
+    scene.destroy_entity(e);
+    cr_assert_eq(scene.get_sparse_set(r::ecs::component_id<Stunned>())->entities().size(), 0u);
+}
+
+Test(Scene, HierarchyIndexKeepsParentsBeforeChildren)
+{
+    r::ecs::Scene scene;
+    const r::ecs::Entity root = scene.create_entity();
+    const r::ecs::Entity a = scene.create_entity();
+    const r::ecs::Entity b = scene.create_entity();
+    const r::ecs::Entity c = scene.create_entity();
+
+    /* c is linked before its parent b gets a parent, depths are fixed up */
+    scene.add_child(b, c);
+    scene.add_child(root, a);
+    scene.add_child(a, b);
+    scene.add_child(c, root);
+
+    const auto &hierarchy = scene.get_hierarchy();
+    const auto &order = hierarchy.depth_order();
+
+    cr_assert_eq(hierarchy.parent(root), r::ecs::NULL_ENTITY, "A link that would create a cycle is refused");
+    cr_assert_eq(order.size(), 3u);
+    cr_assert_eq(order[0].entity, a);
+    cr_assert_eq(order[1].entity, b);
+    cr_assert_eq(order[2].entity, c);
+    cr_assert_eq(hierarchy.depth(c), 3u);
+
+    scene.add_child(root, b);
+    cr_assert_eq(hierarchy.depth(c), 2u);
+    cr_assert(scene.get_component_ptr<r::ecs::Children>(a)->entities.empty(), "Moving a child updates its old parent");
+    cr_assert_eq(scene.get_component_ptr<r::ecs::Parent>(b)->entity, root);
+}
+
+Test(Scene, DespawnRemovesTheWholeSubtree)
+{
+    r::ecs::Scene scene;
+    const r::ecs::Entity root = scene.create_entity();
+    const r::ecs::Entity branch = scene.create_entity();
+    const r::ecs::Entity leaf = scene.create_entity();
+    const r::ecs::Entity other = scene.create_entity();
+
+    scene.add_child(root, branch);
+    scene.add_child(root, other);
+    scene.add_child(branch, leaf);
+
+    scene.destroy_entity(branch);
+    cr_assert_not(scene.is_alive(branch));
+    cr_assert_not(scene.is_alive(leaf));
+    cr_assert(scene.is_alive(other));
+
+    const auto &children = scene.get_component_ptr<r::ecs::Children>(root)->entities;
+    cr_assert_eq(children.size(), 1u);
+    cr_assert_eq(children[0], other);
+    cr_assert_eq(scene.get_hierarchy().first_child(root), other);
+    cr_assert_eq(scene.get_hierarchy().depth_order().size(), 1u);
+}
+
+Test(Scene, HierarchyComponentsGoThroughTheIndex)
+{
+    r::ecs::Scene scene;
+    const r::ecs::Entity root = scene.create_entity();
+    const r::ecs::Entity a = scene.create_entity();
+    const r::ecs::Entity b = scene.create_entity();
+    const auto &hierarchy = scene.get_hierarchy();
+
+    /* a Children component inserted directly links its entities */
+    scene.add_component(root, r::ecs::Children{{a, b}});
+    cr_assert_eq(hierarchy.parent(a), root);
+    cr_assert_eq(scene.get_component_ptr<r::ecs::Parent>(b)->entity, root);
+
+    /* removing Parent detaches the entity, despawning its old parent keeps it */
+    scene.remove_component<r::ecs::Parent>(a);
+    cr_assert_eq(hierarchy.parent(a), r::ecs::NULL_ENTITY);
+    cr_assert(scene.get_component_ptr<r::ecs::Children>(root)->entities == (std::vector<r::ecs::Entity>{b}));
+
+    /* a spawned Parent links too */
+    const r::ecs::Entity c = scene.spawn(r::ecs::Parent{b});
+    cr_assert_eq(hierarchy.parent(c), b);
+    cr_assert_eq(hierarchy.depth_order().size(), 2u);
+
+    scene.destroy_entity(root);
+    cr_assert(scene.is_alive(a));
+    cr_assert_not(scene.is_alive(b));
+    cr_assert_not(scene.is_alive(c), "Children added through components cascade on despawn");
+
+    /* removing Children detaches every child */
+    const r::ecs::Entity d = scene.create_entity();
+    scene.add_component(a, r::ecs::Parent{d});
+    scene.remove_component<r::ecs::Children>(d);
+    cr_assert_eq(hierarchy.parent(a), r::ecs::NULL_ENTITY);
+    cr_assert_eq(scene.get_component_ptr<r::ecs::Parent>(a), nullptr);
+}
+
+Test(Scene, DepthOrderFollowsRandomEdits)
+{
+    r::ecs::Scene scene;
+    std::vector<r::ecs::Entity> entities;
+    std::mt19937 rng(42);
+    const auto &hierarchy = scene.get_hierarchy();
+
+    for (int i = 0; i < 64; ++i) {
+        entities.push_back(scene.create_entity());
+    }
+    for (int step = 0; step < 2000; ++step) {
+        const r::ecs::Entity a = entities[rng() % entities.size()];
+        const r::ecs::Entity b = entities[rng() % entities.size()];
+
+        switch (rng() % 8) {
+            case 0: scene.remove_component<r::ecs::Parent>(a); break;
+            case 1:
+                scene.destroy_entity(a);
+                std::erase_if(entities, [&scene](r::ecs::Entity e) { return !scene.is_alive(e); });
+                while (entities.size() < 64) {
+                    entities.push_back(scene.create_entity());
+                }
+                break;
+            default: scene.add_child(a, b); break;
+        }
+
+        /* every entity with a parent is listed once, after its parent */
+        const auto &order = hierarchy.depth_order();
+        std::unordered_map<r::ecs::Entity, usize> position;
+        for (usize i = 0; i < order.size(); ++i) {
+            cr_assert_eq(hierarchy.parent(order[i].entity), order[i].parent);
+            position[order[i].entity] = i;
+        }
+        usize linked = 0;
+        for (const r::ecs::Entity e : entities) {
+            const r::ecs::Entity parent = hierarchy.parent(e);
+            if (parent == r::ecs::NULL_ENTITY) {
+                continue;
+            }
+            ++linked;
+            cr_assert(position.contains(e));
+            cr_assert(!position.contains(parent) || position[parent] < position[e], "A parent comes before its children");
+            cr_assert_eq(hierarchy.depth(e), hierarchy.depth(parent) + 1);
+        }
+        cr_assert_eq(order.size(), linked);
+    }
+}
+
+Test(Scene, DespawnAllClearsMatchingTables)
+{
+    struct Bullet {
+    };
+
+    r::ecs::Scene scene;
+    std::vector<r::ecs::Entity> bullets;
+    const r::ecs::Entity shield = scene.create_entity();
+    const r::ecs::Entity survivor = scene.create_entity();
+    const r::ecs::Entity parent = scene.create_entity();
+    const r::ecs::Entity child = scene.create_entity();
+
+    for (int i = 0; i < 8; ++i) {
+        const r::ecs::Entity e = scene.create_entity();
+
+        scene.add_component(e, Bullet{});
+        bullets.push_back(e);
+    }
+    scene.add_component(shield, Bullet{});
+    scene.add_component(shield, Health{5});
+    scene.add_component(survivor, Health{7});
+    scene.add_component(parent, Bullet{});
+    scene.add_child(parent, child);
+
+    scene.despawn_all<r::ecs::With<Bullet>, r::ecs::Without<Health>>();
+    for (const r::ecs::Entity e : bullets) {
+        cr_assert_not(scene.is_alive(e));
+    }
+    cr_assert_not(scene.is_alive(parent));
+    cr_assert_not(scene.is_alive(child), "Children of a despawned entity go with it");
+    cr_assert(scene.is_alive(shield));
+    cr_assert_eq(scene.get_component_ptr<Health>(survivor)->value, 7);
+
+    const r::ecs::Entity reused = scene.create_entity();
+    scene.add_component(reused, Bullet{});
+    cr_assert(scene.is_alive(reused), "Freed slots are handed out again");
+    cr_assert_eq(scene.get_component_ptr<Health>(shield)->value, 5);
+}
@@ -0,0 +1,117 @@
+#include "../Test.hpp"
+
+#include "R-Engine/ECS/Scene.hpp"
+#include "R-Engine/ECS/Storage.hpp"
+
+#include <string>
+
+static int g_live_tracked = 0;
+
+struct Tracked {
+        std::string name;
+
+        explicit Tracked(std::string n) : name(std::move(n))
+        {
+            ++g_live_tracked;
+        }
+        Tracked(const Tracked &other) : name(other.name)
+        {
+            ++g_live_tracked;
+        }
+        Tracked(Tracked &&other) noexcept : name(std::move(other.name))
+        {
+            ++g_live_tracked;
+        }
+        Tracked &operator=(const Tracked &) = default;
+        Tracked &operator=(Tracked &&) noexcept = default;
+        ~Tracked()
+        {
+            --g_live_tracked;
+        }
+};
+
+struct Marker {
+        int value = 0;
+};
+
+Test(Storage, ComponentInfoDescribesType)
+{
+    const auto &trivial = r::ecs::component_info<Marker>();
+    const auto &tracked = r::ecs::component_info<Tracked>();
+
+    cr_assert_eq(trivial.size, sizeof(Marker));
+    cr_assert_eq(trivial.alignment, alignof(Marker));
+    cr_assert(trivial.trivially_relocatable);
+    cr_assert_not(tracked.trivially_relocatable);
+    cr_assert(&r::ecs::component_info<Marker>() == &trivial, "Descriptors are registered once per type");
+}
+
+Test(Storage, ColumnSwapRemove)
+{
+    r::ecs::Column column(&r::ecs::component_info<Marker>());
+
+    for (int i = 0; i < 100; ++i) {
+        Marker m{i};
+        column.push_move(&m, 1);
+    }
+    column.remove_swap_back(10);
+
+    cr_assert_eq(column.size(), 99u);
+    cr_assert_eq(static_cast<Marker *>(column.get_ptr(10))->value, 99, "Last element should be moved into the removed slot");
+}
+
+Test(Storage, NonTrivialComponentsSurviveArchetypeMoves)
+{
+    g_live_tracked = 0;
+    {
+        r::ecs::Scene scene;
+        const auto e1 = scene.create_entity();
+        const auto e2 = scene.create_entity();
+
+        scene.add_component(e1, Tracked{"first"});
+        scene.add_component(e2, Tracked{"second"});
+        scene.add_component(e1, Marker{1});
+        scene.remove_component<Marker>(e1);
+
+        cr_assert_eq(scene.get_component_ptr<Tracked>(e1)->name, "first");
+        cr_assert_eq(scene.get_component_ptr<Tracked>(e2)->name, "second");
+        cr_assert_eq(g_live_tracked, 2);
+
+        scene.destroy_entity(e1);
+        cr_assert_eq(g_live_tracked, 1);
+        cr_assert_eq(scene.get_component_ptr<Tracked>(e2)->name, "second");
+    }
+    cr_assert_eq(g_live_tracked, 0, "Every component should be destroyed exactly once");
+}
+
+Test(Storage, ComponentIdsAreDenseAndStable)
+{
+    struct IdA {};
+    struct IdB {};
+
+    const auto a = r::ecs::component_id<IdA>();
+    const auto b = r::ecs::component_id<IdB>();
+
+    cr_assert_neq(a, b);
+    cr_assert_eq(r::ecs::component_id<IdA>(), a);
+    cr_assert_eq(r::ecs::register_component_id(typeid(IdB)), b, "Registering an existing type must return its ID");
+    cr_assert_lt(a, r::ecs::MAX_COMPONENTS);
+    cr_assert_eq(r::ecs::component_info<IdA>().id, a);
+}
+
+Test(Storage, ArchetypeSignatureAndColumnLookup)
+{
+    r::ecs::Scene scene;
+    const auto e = scene.create_entity();
+
+    scene.add_component(e, Marker{7});
+
+    const auto *loc = scene.get_entity_location(e);
+    const auto &archetype = scene.get_archetypes()[loc->archetype_index];
+    const auto marker_id = r::ecs::component_id<Marker>();
+
+    cr_assert(archetype.mask.test(marker_id));
+    cr_assert_eq(archetype.mask.count(), 1u);
+    cr_assert_eq(archetype.column_index(marker_id), 0u);
+    cr_assert_eq(archetype.column_index(r::ecs::component_id<Tracked>()), r::ecs::INVALID_INDEX);
+}